@@ -0,0 +1,80 @@
+#pragma once
+#include <glad/glad.h>
+#include "streamBuffer.h"
+#include <cstdint>
+
+namespace ech {
+
+    struct RenderStats;
+    struct QuadInstance;
+    struct TextureRegion;
+
+    // One vertex of the CPU side batch
+    struct BatchVertex {
+        float x, y;          // Position (world pixels)
+        float u, v;          // Texture coordinates, position relative to the center for SDF shapes
+        float r, g, b, a;    // Color / tint
+        float halfWidth, halfHeight, cornerRadius, thickness; // SDF shape, all 0 for everything else
+    };
+
+    // Creates the VAO, VBO and the static quad index buffer used by the batch
+    void InitBatchRenderer();
+    void ShutdownBatchRenderer();
+
+    // Appends one quad (4 vertices, counter-clockwise) to the batch.
+    // If the program or texture differ from what is already batched, the batch is flushed first,
+    // so draw order is always the same as call order. Use texture 0 for untextured shapes.
+    void BatchQuad(GLuint program, GLuint texture, const BatchVertex* vertices);
+
+    // Same as BatchQuad but for a single triangle (it is stored as a degenerate quad)
+    void BatchTriangle(GLuint program, GLuint texture, const BatchVertex& a, const BatchVertex& b, const BatchVertex& c);
+
+    // Uploads everything batched so far and issues one draw call for it.
+    // In command buffer mode the recorded quads are sorted and submitted first.
+    void FlushBatch();
+
+    // Streams the instances and draws them with glDrawElementsInstanced (split only if they don't fit a stream segment)
+    // uvRegion (u0, v0, u1, v1) is the part of the texture the instance UVs are relative to
+    void DrawInstancedQuads(GLuint program, GLuint texture, const float uvRegion[4], const QuadInstance* instances, size_t count);
+
+    // Counts draw calls in the culled / submitted stats (of the draw list if this thread is filling one)
+    void CountCullResult(bool visible, int count = 1);
+
+    // The render thread state draws read: where they go, the camera zoom and the built-in programs.
+    // The render thread sets it for the camera view or the render layer being drawn. BeginDrawList copies it into the
+    // list, so worker threads read that copy and never the one the render thread changes.
+    struct DrawState {
+        float cullMinX = 0.0f, cullMinY = 0.0f, cullMaxX = 0.0f, cullMaxY = 0.0f; // Draws outside are culled
+        float height = 0.0f;        // y down draws flip against it
+        float cameraZoom = 1.0f;    // 1 inside render layers, the camera doesn't apply there
+        GLuint shapeProgram = 0;
+        GLuint textureProgram = 0;
+    };
+
+    void SetDrawState(const DrawState& state); // Render thread only
+    const DrawState& GetDrawState();           // The draw list's copy while this thread fills one
+
+    // Texture slots as draw lists see them, BeginDrawList copies the table into the list the same way.
+    // The render thread publishes every slot change, region is nullptr once the slot is unloaded.
+    void PublishTextureSlot(uint32_t index, uint32_t generation, const TextureRegion* region);
+    // The region in the copy of the list this thread is filling, nullptr if the handle is stale there
+    const TextureRegion* GetRecordedTextureRegion(uint32_t index, uint32_t generation);
+
+    bool IsRecordingDrawList();
+    // Draws that make OpenGL calls start with this, while the thread fills a draw list it prints an error and returns true
+    bool RejectWhileRecording(const char* function);
+
+    // Called by StartDrawing / EndDrawing
+    void BeginBatchFrame();
+    void EndBatchFrame();
+
+    // Stats of the frame currently being recorded
+    RenderStats& GetFrameStats();
+
+    // Static index buffer for MAX_BATCH_QUADS (8192) quads, 0 1 2 2 3 0 per quad
+    GLuint GetQuadIndexBuffer();
+
+    // Ring buffer all per frame vertex data is written to
+    StreamBuffer& GetVertexStream();
+
+}
@@ -16,9 +16,10 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <fstream>
 #include <ostream>
+#include <cstdint>
+#include <functional>
+#include <memory>
 
-#define FONT_BITMAP_WIDTH 1024 * 2
-#define FONT_BITMAP_HEIGHT 1024 * 2
 
 
 
@@ -38,6 +39,24 @@ namespace ech {
 
     extern std::unordered_map<std::string, GLuint> textures;
 
+    // Where a named image lives: its own texture, or a rectangle of an atlas page
+    struct TextureRegion {
+        GLuint textureID;
+        float u0, v0, u1, v1;   // Top-left and bottom-right texture coordinates
+        int width, height;      // Size in pixels
+    };
+
+    // Reference to a loaded texture: a slot index plus the generation of that slot.
+    // Unloading bumps the generation, so old handles stop resolving instead of drawing whatever reused the slot.
+    struct TextureHandle {
+        uint32_t index = 0;
+        uint32_t generation = 0;    // Slots start at generation 1, so a default handle is always invalid
+
+        bool IsValid() const { return generation != 0; }
+    };
+
+    extern std::unordered_map<std::string, TextureHandle> textureHandles; // Name lookup for the string API
+
     enum class TextureType {
         NEAREST = GL_NEAREST,
         LINEAR = GL_LINEAR
@@ -56,13 +75,25 @@ namespace ech {
         Camera() : x(0), y(0), rotation(0), zoom(1.0f) {} // Constructor to initialize defaults
     };
 
-    inline Camera camera; // Declare a global camera instance
+    inline Camera camera; // Global camera, read once per frame by StartDrawing
+
+    // Everything the draw functions need about the current frame, filled once by StartDrawing
+    struct FrameContext {
+        int windowWidth, windowHeight;              // Screen coordinates, what draw positions are in
+        int framebufferWidth, framebufferHeight;    // Pixels, bigger than the window on HiDPI screens
+        float contentScaleX, contentScaleY;         // HiDPI scale of the monitor the window is on
+        glm::mat4 viewProjection;                   // Built from ech::camera
+        uint64_t frameIndex;                        // Counts up once per StartDrawing
+        float deltaTime;                            // Seconds since the previous StartDrawing, 0 on the first frame
+        double time;                                // Seconds since the first StartDrawing
+        float viewMinX, viewMinY, viewMaxX, viewMaxY; // World rectangle the camera sees (its bounding box when rotated)
+    };
+
+    class GlyphCache;
 
     struct Font {
-        GLuint textureID;
-        int textureWidth;
-        int textureHeight;
-        stbtt_bakedchar characterData[256]; // 95 ASCII characters
+        std::shared_ptr<GlyphCache> glyphs;   // Glyphs get rasterized the first time they are drawn, copies share them
+        int size;                             // Pixel height the font was loaded with
     };
 
     struct Vec2 {
@@ -230,22 +261,64 @@ namespace ech {
 #define MOUSE_MIDDLE_BUTTON GLFW_MOUSE_BUTTON_MIDDLE
 
     // Function declarations
+    // Keeps linked shader program binaries in this directory (created if missing), so later runs skip compiling.
+    // Call it before MakeWindow, the built-in shaders are built there. Off until this is called.
+    bool SetShaderCacheDirectory(const std::string& directory);
     void MakeWindow(int width, int height, const char* title);
     void CloseWindow();
     int WindowShouldClose();
     void StartDrawing();
     void EndDrawing();
     void ClearBackground(Color color);
-    void SetTargetFps(int targetFps);
+    void SetTargetFps(int targetFps); // Frame limiter in EndDrawing, 0 runs uncapped. Ignored while vsync is on.
+    void SetVsync(bool enabled); // Let the swap wait for the display instead of the frame limiter, off by default
+    const FrameContext& GetFrameContext();
+
+    // Render Layers
+    // Offscreen target for content that rarely changes (backgrounds, UI panels). It is drawn only when dirty
+    // and composited every frame as one textured quad.
+    struct RenderLayer {
+        GLuint framebuffer = 0;
+        GLuint texture = 0;     // Premultiplied alpha, bottom row first like every framebuffer
+        int width = 0, height = 0;
+        bool dirty = true;      // Set by MarkRenderLayerDirty, cleared by EndRenderLayer
+    };
+
+    bool CreateRenderLayer(RenderLayer& layer, int width, int height);
+    void DestroyRenderLayer(RenderLayer& layer);
+    void MarkRenderLayerDirty(RenderLayer& layer);
+    // Only returns true when the layer is dirty, then every draw until EndRenderLayer goes into it (cleared first).
+    // Inside, coordinates are layer pixels with (0, 0) at the bottom-left and the camera doesn't apply.
+    // Draws taking y downwards (DrawProTexturedRectangle) count it from the top of the layer.
+    //   if (BeginRenderLayer(layer)) { ...draws...; EndRenderLayer(layer); }
+    bool BeginRenderLayer(RenderLayer& layer);
+    void EndRenderLayer(RenderLayer& layer);
+    // The layer as one quad with its bottom-left at x, y in world pixels
+    void DrawRenderLayer(const RenderLayer& layer, float x, float y, float alpha = 1.0f);
+
+    // Headless Rendering
+    // Like MakeWindow, but the window is never shown and every frame is drawn into an offscreen framebuffer of
+    // width x height. Meant for rendering tests and servers. Without any display, configure GLFW with
+    // -DGLFW_USE_OSMESA=ON so the context comes from OSMesa (Mesa llvmpipe), otherwise Xvfb is enough.
+    void MakeHeadlessWindow(int width, int height);
+    bool IsHeadless();
+    // The last finished frame (call after EndDrawing) as tightly packed RGBA rows, top row first.
+    // Headless this reads the offscreen framebuffer, with a window it reads the front buffer.
+    bool ReadPixels(std::vector<unsigned char>& outPixels, int& outWidth, int& outHeight);
+    bool SaveScreenshot(const char* filepath); // ReadPixels written as a PNG
 
     // Shape Rendering
     void DrawTriangle(float x, float y, float width, float height, const Color& color);
     void DrawRectangle(float x, float y, float width, float height, const Color& color);
     void DrawProRectangle(float x, float y, float width, float height, const Color& color, float angle, float transparency);
-    void DrawCircle(float centerX, float centerY, float radius, const Color& color, int segments = 36);
+    void DrawCircle(float centerX, float centerY, float radius, const Color& color, int segments = 36); // segments is ignored, circles are exact
     void DrawProCircle(float centerX, float centerY, float radius, const Color& color, int segments, float transparency);
+    void DrawRing(float centerX, float centerY, float radius, float thickness, const Color& color);
+    void DrawRoundedRectangle(float x, float y, float width, float height, float cornerRadius, const Color& color);
+    void DrawRoundedRectangleOutline(float x, float y, float width, float height, float cornerRadius, float thickness, const Color& color);
     void DrawProTriangle(float x, float y, float width, float height, const Color& color, float transparency);
     void DrawProTexturedRectangle(float x, float y, float width, float height, float rotation, float alpha, const std::string& name);
+    void DrawProTexturedRectangle(float x, float y, float width, float height, float rotation, float alpha, TextureHandle texture);
 
     // Input System
     int IsKeyPressed(int key);
@@ -255,14 +328,153 @@ namespace ech {
     int IsMouseButtonHeld(int button);
 
     // Texture Rendering
-    void LoadTexture(const char* filepath, const std::string& name);
+    // Keep the returned handle for drawing, the name versions have to look the texture up every call
+    TextureHandle LoadTexture(const char* filepath, const std::string& name);
+    TextureHandle GetTextureHandle(const std::string& name); // Invalid handle if nothing has that name
+    const TextureRegion* GetTextureRegion(TextureHandle texture); // nullptr if the handle is invalid or stale
+    void UnloadTexture(TextureHandle texture);
     void DrawTexturedRectangle(float x, float y, float width, float height, const std::string& name);
+    void DrawTexturedRectangle(float x, float y, float width, float height, TextureHandle texture);
+
+    // Async Texture Loading
+    // Called from StartDrawing once the texture is uploaded, or once loading it failed
+    using TextureLoadedCallback = std::function<void(const std::string& name, TextureHandle texture, bool success)>;
+
+    struct TextureLoadProgress {
+        int requested;  // Counted from the first request after everything was finished
+        int loaded;
+        int failed;
+    };
+
+    // Returns right away, the handle draws a placeholder until the image is decoded and uploaded
+    TextureHandle LoadTextureAsync(const char* filepath, const std::string& name, TextureLoadedCallback onLoaded = nullptr);
+    TextureLoadProgress GetTextureLoadProgress();
+    void SetTextureUploadBudget(float milliseconds); // Upload time StartDrawing may spend per frame, 2 ms by default
+
+    // Texture Atlas
+    // Packs many images (name, file path) into a few big pages and saves them to one file.
+    // Run it once while building the game, then ship and load the atlas file instead of the images.
+    bool BuildTextureAtlas(const std::vector<std::pair<std::string, std::string>>& images, const char* atlasFile, int pageSize = 2048);
+    // Registers every image of the atlas by name, GetTextureHandle(name) then points into the atlas page
+    bool LoadTextureAtlas(const char* atlasFile);
+
+    // Instanced Rendering (one draw call for many quads)
+    struct QuadInstance {
+        float x, y;                 // Bottom-left corner in pixels
+        float width, height;
+        float u0, v0, u1, v1;       // Texture region, top-left and bottom-right (0, 0, 1, 1 is the whole texture)
+        Color color;                // Color for rectangles, tint for textures
+        float rotation;             // Degrees, around the center
+    };
+
+    void DrawRectangleInstanced(const QuadInstance* instances, size_t count);
+    void DrawTexturedInstanced(const QuadInstance* instances, size_t count, const std::string& name);
+    void DrawTexturedInstanced(const QuadInstance* instances, size_t count, TextureHandle texture);
+
+    // Tilemap
+    // Tile indices into a tileset image, drawn from one static vertex buffer per 32x32 tile chunk.
+    // A chunk is rebuilt only after one of its tiles changed, and only chunks the camera sees are drawn.
+    // Like render layers, the chunk buffers are only freed by Destroy (before CloseWindow), the destructor makes no OpenGL call.
+    class Tilemap {
+    public:
+        static const int CHUNK_SIZE = 32;
+
+        Tilemap() = default;
+        Tilemap(const Tilemap&) = delete;
+        Tilemap& operator=(const Tilemap&) = delete;
+
+        // Tiles are tilePixelWidth x tilePixelHeight cells of the tileset, numbered row by row from its top-left.
+        // The map is width x height tiles of tileSize world pixels, tile (0, 0) has its bottom-left at originX, originY.
+        // Every tile starts empty.
+        bool Create(int width, int height, float tileSize, TextureHandle tileset, int tilePixelWidth, int tilePixelHeight,
+            float originX = 0.0f, float originY = 0.0f);
+        void Destroy();
+
+        void SetTile(int x, int y, int tile); // -1 empties the tile
+        int GetTile(int x, int y) const;      // -1 for empty tiles and outside the map
+
+        int GetWidth() const { return width; }
+        int GetHeight() const { return height; }
+
+    private:
+        struct Chunk {
+            GLuint vao = 0;
+            GLuint vbo = 0;
+            int quadCount = 0;
+            bool dirty = true;
+        };
+
+        int width = 0, height = 0;
+        int chunksX = 0, chunksY = 0;
+        float tileSize = 0.0f;
+        float originX = 0.0f, originY = 0.0f;
+        TextureHandle tileset;
+        int tilePixelWidth = 0, tilePixelHeight = 0;
+        TextureRegion builtWith = {};   // Tileset region the chunk UVs were built from
+        std::vector<int> tiles;
+        std::vector<Chunk> chunks;
+
+        void BuildChunk(int chunkX, int chunkY, const TextureRegion& region);
+        void Draw(GLuint program, float minX, float minY, float maxX, float maxY);
+
+        friend void DrawTilemap(Tilemap& map);
+    };
 
-    bool LoadFont(const char* fontFile, int fontSize, Font& outFont);
+    // Render thread only, draws immediately (after flushing the batch so order is kept).
+    // Every chunk counts as one draw in the culled / submitted stats.
+    void DrawTilemap(Tilemap& map);
+
+    enum class FontType {
+        BITMAP,     // Sharpest at the size it was loaded with, can't be scaled
+        SDF         // Signed distance field, one atlas draws crisp text at any size and camera zoom
+    };
+
+    // For SDF fonts fontSize is only the rasterization size, 32-64 is plenty for any size on screen
+    bool LoadFont(const char* fontFile, int fontSize, Font& outFont, FontType type = FontType::BITMAP);
+
+    // Keeps the baked printable ASCII glyphs of every loaded font and size in this directory (created if missing).
+    // Later runs map the cache file and upload it as is instead of rasterizing. Off until this is called.
+    bool SetFontCacheDirectory(const std::string& directory);
+    // text is UTF-8, x, y is the start of the baseline.
+    // SDF fonts are drawn at fontSize, bitmap fonts always at the size they were loaded with.
     void DrawText(Font& font, const char* text, float x, float y, int fontSize, Color color);
 
+    // Text Layout (for text that doesn't change every frame)
+    struct TextLayoutGlyph {
+        uint32_t codepoint;
+        float x, y;                 // Pen position relative to the start of the first baseline
+    };
+
+    struct TextLayout {
+        std::vector<TextLayoutGlyph> glyphs;    // Only glyphs that draw something, spaces are left out
+        float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f; // Bounding box relative to the start of the first baseline, y grows upwards
+        int lineCount = 0;
+
+        // What it was shaped from, ShapeText skips all work if none of it changed
+        std::string text;
+        const GlyphCache* shapedWith = nullptr;
+        float scale = 1.0f;
+        float maxWidth = 0.0f;
+    };
+
+    // Positions every glyph once, with kerning and word wrapping at maxWidth (0 only breaks at '\n').
+    // Cheap to call every frame, it only shapes again when the text, font, size or width changed.
+    void ShapeText(TextLayout& layout, Font& font, const char* text, int fontSize, float maxWidth = 0.0f);
+    // x, y is the start of the first baseline, font has to be the one the layout was shaped with
+    void DrawTextLayout(Font& font, const TextLayout& layout, float x, float y, Color color);
+
     // Time Management
-    float GetDeltaTime();
+    float GetDeltaTime(); // Same value for the whole frame, measured once by StartDrawing
+
+    // Fixed Timestep
+    // StartDrawing runs update as many times as there are whole steps of frame time, so the simulation
+    // advances at the same rate no matter how fast frames are rendered. After a long stall at most
+    // maxStepsPerFrame steps run and the rest of the time is dropped, instead of falling further behind.
+    using FixedUpdateCallback = std::function<void(float step)>;
+    void SetFixedUpdate(FixedUpdateCallback update, float stepSeconds = 1.0f / 60.0f, int maxStepsPerFrame = 8);
+    // How far the current frame is between the last two fixed updates (0..1).
+    // Draw at Lerp(previousState, currentState, alpha) for smooth motion at any frame rate.
+    float GetInterpolationAlpha();
 
     //  Mouse Stuff
     void GetMousePosition(double& x, double& y);
@@ -272,6 +484,84 @@ namespace ech {
 
     void DrawRectangleCollisionShape(float x, float y, float width, float height, const Color& color);
 
+    // Renderer Stats
+    struct RenderStats {
+        int drawCalls;      // glDraw* calls issued during the frame
+        int quads;          // Quads (and triangles) that went through the batch
+        size_t bytesStreamed; // Vertex data written to the stream buffer
+        int glCallsElided;  // Program / VAO / texture binds skipped because they were already bound
+        int culled;         // Draw calls skipped because they were outside the camera view (or render layer)
+        int submitted;      // Draw calls that passed the culling test
+    };
+
+    const RenderStats& GetRenderStats(); // Stats of the last finished frame
+
+    // Frame Pacing
+    // Measured from one EndDrawing to the next, over the last 120 frames
+    struct FrameTimeStats {
+        float frameMs;      // Last frame
+        float averageMs;
+        float minMs, maxMs;
+        float jitterMs;     // Standard deviation of the frame time
+        float targetMs;     // What the limiter aims for, 0 when it is off (no target fps or vsync)
+    };
+
+    const FrameTimeStats& GetFrameTimeStats();
+
+    // Command Buffer
+    // With it on, quads are recorded and submitted at EndDrawing (or when a render layer or atlas change needs the GPU
+    // to catch up), sorted by draw layer first, then by shader and texture. Order is kept between layers and between
+    // draws with the same shader and texture. Overlapping draws in one layer with different textures may swap,
+    // give those different layers.
+    void SetCommandBufferMode(bool enabled);
+    void SetDrawLayer(int layer); // 0..255, higher draws on top, 0 by default. Only used in command buffer mode.
+
+    // Draw Lists
+    // Lets worker threads build draw data in parallel. Between BeginDrawList and EndDrawList, the shape and textured
+    // rectangle draws of the calling thread (and its SetDrawLayer) go into the list and make no OpenGL call.
+    // BeginDrawList copies what those draws read from the render thread: the camera view (or render layer) the list is
+    // culled against, the zoom, the built-in shader programs and the texture table. Begin it after StartDrawing and
+    // get texture handles beforehand. Draws that make OpenGL calls (text, instanced, tilemaps, render layers) print an
+    // error and do nothing while the thread fills a list, they still have to happen on the render thread.
+    struct DrawListData;
+
+    class DrawList {
+    public:
+        DrawList();
+        ~DrawList();
+        DrawList(DrawList&&) noexcept;
+        DrawList& operator=(DrawList&&) noexcept;
+
+        void Clear();
+        size_t GetQuadCount() const; // 0 for a moved-from list, which can be filled again with BeginDrawList
+
+    private:
+        std::unique_ptr<DrawListData> data;
+
+        friend void BeginDrawList(DrawList& list);
+        friend void EndDrawList(DrawList& list);
+        friend void SubmitDrawList(const DrawList& list);
+    };
+
+    void BeginDrawList(DrawList& list); // Clears the list first
+    void EndDrawList(DrawList& list);
+    // Render thread, between StartDrawing and EndDrawing, once the worker is done with the list.
+    // Its quads are drawn at this point, lists submitted one after the other keep their order.
+    void SubmitDrawList(const DrawList& list);
+
+    // Call this after using OpenGL directly (or another renderer) so Echlib doesn't skip binds it needs
+    void ResetGlStateCache();
+
+    // Shader Registry
+    // Builds a program from a vertex and a fragment shader file and keeps it under name.
+    // Outside PRODUCTION_BUILD (Linux) the files are watched and the program is rebuilt between frames when
+    // one of them is saved. If the edit doesn't compile the last good program stays in use.
+    // uViewProjection (mat4) is set to the camera, or the render layer being drawn, like in the built-in shaders.
+    // Those are registered too, from RESOURCES_PATH "shaders/", as "shape", "texture", "text" and "text_sdf".
+    bool LoadShaderProgram(const std::string& name, const std::string& vertexFile, const std::string& fragmentFile);
+    // Current program for name, 0 if it never built. Look it up every frame, a reload replaces it.
+    GLuint GetShaderProgram(const std::string& name);
+
     // Template function to save data to a file
     template <typename T>
     inline void savefile(const std::string& filename, const T& data) {
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace ech {
+
+    // Called by EndDrawing right after the swap. With limit set (vsync off) and a target fps it waits for the
+    // next frame's deadline, then it records the frame time for GetFrameTimeStats either way.
+    void PaceFrame(bool limit);
+
+}
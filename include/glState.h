@@ -0,0 +1,27 @@
+#pragma once
+#include <glad/glad.h>
+
+namespace ech {
+
+    // Small layer over the GL calls the renderer issues all the time.
+    // Binds are skipped when the same object is already bound, every skip is counted
+    // in RenderStats::glCallsElided.
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vao);
+    void BindTexture(GLuint texture); // GL_TEXTURE_2D on texture unit 0
+
+    // glDeleteTextures that also forgets the binding, so a new texture reusing the id still gets bound
+    void DeleteTexture(GLuint texture);
+
+    // Reads every active uniform of a linked program, call it right after glLinkProgram
+    void CacheProgramUniforms(GLuint program);
+    void ForgetProgramUniforms(GLuint program);
+
+    // Location from the cache, -1 if the program doesn't have it
+    GLint GetUniformLocation(GLuint program, const char* name);
+
+    // Forget what is bound, needed after GL calls that didn't go through these functions
+    void ResetGlStateCache();
+
+}
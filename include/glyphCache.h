@@ -0,0 +1,83 @@
+#pragma once
+#include <glad/glad.h>
+#include <stb_truetype/stb_truetype.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace ech {
+
+    // Rasterizes glyphs the first time they are drawn and keeps them in a single channel atlas.
+    // The atlas is packed in shelves (rows of glyphs of similar height), it doubles in size when full
+    // and once it can't grow anymore the least recently used shelf is cleared and reused.
+    class GlyphCache {
+    public:
+        struct Glyph {
+            int x, y, width, height;    // Pixels in the atlas, width / height are 0 for glyphs without pixels (space)
+            float xoff, yoff;           // Top-left of the bitmap relative to the pen, y grows downwards like in stb_truetype
+            float advance;              // How far the pen moves after this glyph
+            int shelf;                  // -1 if the glyph has no pixels
+        };
+
+        // Takes over the TTF file contents, glyphs are rasterized from them on demand.
+        // With sdf the atlas stores signed distances (edge at 0.5) instead of coverage.
+        bool Init(std::vector<unsigned char> fontData, float pixelHeight, bool sdf = false);
+
+        // Makes sure every codepoint of the UTF-8 text is in the atlas and marks it as used this frame.
+        // Call it before looking glyphs up, rasterizing can grow the atlas and move every UV.
+        void Prepare(const char* text);
+        void Prepare(uint32_t codepoint);
+
+        // Atlas and glyphs as a cache file, LoadCache only accepts files written for the same font hash,
+        // size and type. Loading maps the file and uploads the atlas straight from it.
+        bool SaveCache(const char* filepath, uint64_t fontHash) const;
+        bool LoadCache(const char* filepath, uint64_t fontHash);
+
+        // nullptr if the codepoint was never prepared or got evicted
+        const Glyph* FindGlyph(uint32_t codepoint) const;
+
+        GLuint GetTexture() const { return texture; }
+        int GetAtlasWidth() const { return atlasWidth; }
+        int GetAtlasHeight() const { return atlasHeight; }
+        float GetPixelHeight() const { return pixelHeight; }
+        bool IsSdf() const { return sdf; }
+
+        // Font metrics at the rasterization size, y grows upwards (descent is negative)
+        float GetAscent() const { return ascent; }
+        float GetDescent() const { return descent; }
+        float GetLineHeight() const { return ascent - descent + lineGap; }
+        float GetKerning(uint32_t left, uint32_t right) const;
+
+    private:
+        struct Shelf {
+            int y, height;
+            int usedWidth;
+            uint64_t lastUsed;              // Frame index of the newest glyph drawn from this shelf
+            std::vector<uint32_t> glyphs;   // Codepoints living in this shelf, removed together on eviction
+        };
+
+        std::vector<unsigned char> fontData;
+        stbtt_fontinfo fontInfo = {};
+        float pixelHeight = 0.0f;
+        float scale = 0.0f;
+        bool sdf = false;
+        float ascent = 0.0f;
+        float descent = 0.0f;
+        float lineGap = 0.0f;
+
+        std::unordered_map<uint32_t, Glyph> glyphs;
+        std::vector<Shelf> shelves;
+
+        std::vector<unsigned char> pixels; // CPU copy of the atlas, needed to keep the contents when it grows
+        int atlasWidth = 0;
+        int atlasHeight = 0;
+        GLuint texture = 0;
+
+        void CreateAtlas();
+        bool Rasterize(uint32_t codepoint, uint64_t frame);
+        int FindShelf(int width, int height, uint64_t frame);
+        bool Grow();
+        void UploadRegion(int x, int y, int width, int height);
+    };
+
+}
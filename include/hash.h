@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace ech {
+
+    // 64 bit FNV-1a, good enough to tell files and shader sources apart for caching (not for security).
+    // Pass a previous result as seed to hash several pieces as one.
+    inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+}
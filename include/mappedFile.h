@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+namespace ech {
+
+    // Read-only memory mapping of a whole file, unmapped again when it goes out of scope
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const char* filepath);
+        void Close();
+
+        const unsigned char* GetData() const { return data; }
+        size_t GetSize() const { return size; }
+
+    private:
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+    };
+
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace ech {
+
+    // Writes tightly packed RGBA8 rows (top row first) as a PNG file.
+    // The image data is stored without compression, it is meant for screenshots and test output, not assets.
+    bool WritePng(const char* filepath, const unsigned char* pixels, int width, int height);
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <glad/glad.h>
+
+namespace ech {
+
+    // Compiles both stages, links them and reads every uniform location into the cache (see glState.h).
+    // With a shader cache directory and GL_ARB_get_program_binary, the linked binary is kept on disk and
+    // loaded instead of compiling while the sources and the driver stay the same.
+    // Returns 0 if compiling or linking failed, the errors are printed with name in front.
+    GLuint BuildShaderProgram(const char* name, const char* vertexSource, const char* fragmentSource);
+
+}
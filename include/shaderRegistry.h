@@ -0,0 +1,17 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ech {
+
+    // Called by StartDrawing: rebuilds the programs whose files changed since the last frame.
+    // Only does something outside PRODUCTION_BUILD on Linux, the files are watched with inotify.
+    void UpdateShaderRegistry();
+
+    // Sets uViewProjection on every registered program, the built-in ones included.
+    // Programs built later (loaded or reloaded) get the last one set.
+    void SetRegistryViewProjection(const glm::mat4& viewProjection);
+
+    // Called by CloseWindow
+    void ShutdownShaderRegistry();
+
+}
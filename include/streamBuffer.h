@@ -0,0 +1,61 @@
+#pragma once
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+namespace ech {
+
+    // How the stream buffer gets data to the GPU, picked in Init from what the driver supports
+    enum class StreamMode {
+        PERSISTENT,         // GL 4.4 / ARB_buffer_storage, mapped once and written directly
+        UNSYNCHRONIZED,     // Plain GL 3.3, glMapBufferRange with GL_MAP_UNSYNCHRONIZED_BIT
+        SUB_DATA            // Last resort if mapping fails, glBufferSubData from a CPU copy
+    };
+
+    // A ring of segments inside one GL buffer. Each segment is protected by a fence, so the CPU
+    // only writes where the GPU is done reading and nothing ever gets reallocated or orphaned.
+    class StreamBuffer {
+    public:
+        static const int SEGMENT_COUNT = 3; // Triple buffered
+
+        void Init(GLenum target, size_t segmentSize);
+        void Shutdown();
+
+        // Returns a pointer where `size` bytes can be written, offset is where they land in the buffer.
+        // Returns nullptr if size is bigger than a segment.
+        void* Map(size_t size, size_t alignment, size_t& outOffset);
+        void Unmap();
+
+        // Fences the current segment and moves on to the next one
+        void NextSegment();
+
+        // Bytes handed out by Map since the last ResetStats
+        size_t GetBytesStreamed() const { return bytesStreamed; }
+        void ResetStats() { bytesStreamed = 0; }
+
+        GLuint GetBuffer() const { return buffer; }
+        GLenum GetTarget() const { return target; }
+        StreamMode GetMode() const { return mode; }
+        size_t GetSegmentSize() const { return segmentSize; }
+
+    private:
+        GLuint buffer = 0;
+        GLenum target = GL_ARRAY_BUFFER;
+        StreamMode mode = StreamMode::SUB_DATA;
+        size_t segmentSize = 0;
+
+        int segment = 0;                // Segment currently written to
+        size_t segmentUsed = 0;         // Bytes used in the current segment
+        GLsync fences[SEGMENT_COUNT] = {};
+
+        unsigned char* persistentPointer = nullptr;
+        std::vector<unsigned char> staging; // Used by SUB_DATA
+        size_t mappedOffset = 0;
+        size_t mappedSize = 0;
+        bool mapped = false;
+        size_t bytesStreamed = 0;
+
+        void WaitForSegment(int index);
+    };
+
+}
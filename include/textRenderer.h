@@ -0,0 +1,29 @@
+#pragma once
+#include "batchRenderer.h"
+#include <cstdint>
+#include <vector>
+
+namespace ech {
+
+    struct Font;
+    struct Color;
+    struct TextLayout;
+
+    // How much glyphs are scaled to draw at fontSize. Distance fields scale cleanly,
+    // plain bitmaps are always drawn at the size they were rasterized at.
+    float GetTextScale(const Font& font, int fontSize);
+
+    // Decodes one UTF-8 character and moves text past it, broken sequences come back as U+FFFD
+    uint32_t NextCodepoint(const char*& text);
+
+    // Appends 4 batch vertices (bottom-left, bottom-right, top-right, top-left) for every visible glyph.
+    // x, y is the start of the baseline, y grows upwards like in every other draw call.
+    // scale multiplies the size the glyphs were rasterized at.
+    // Only reads glyphs the font's cache already has (see GlyphCache::Prepare) and makes no GL calls,
+    // so the output can be compared against expected layouts.
+    void BuildTextVertices(const Font& font, const char* text, float x, float y, float scale, const Color& color, std::vector<BatchVertex>& outVertices);
+
+    // Same as BuildTextVertices for an already shaped layout, x, y is the start of its first baseline
+    void BuildTextLayoutVertices(const Font& font, const TextLayout& layout, float x, float y, const Color& color, std::vector<BatchVertex>& outVertices);
+
+}
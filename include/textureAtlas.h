@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace ech {
+
+    // Bottom-left skyline rectangle packer, used to lay out atlas pages
+    class SkylinePacker {
+    public:
+        void Init(int width, int height);
+
+        // Finds a spot for a width x height rectangle, returns false if the page is full
+        bool Insert(int width, int height, int& outX, int& outY);
+
+        // Highest point used so far, pages get trimmed to this when saved
+        int GetUsedHeight() const { return usedHeight; }
+
+    private:
+        struct Node {
+            int x, y, width;
+        };
+
+        std::vector<Node> skyline;
+        int pageWidth = 0;
+        int pageHeight = 0;
+        int usedHeight = 0;
+
+        // Returns the y a rectangle would sit at if placed on node `index`, or -1 if it doesn't fit
+        int Fit(size_t index, int width, int height) const;
+    };
+
+    // One image inside an atlas, in pixels of its page
+    struct AtlasEntry {
+        std::string name;
+        int page;
+        int x, y, width, height;
+    };
+
+    // A packed atlas before it is uploaded: RGBA pages plus where every image went
+    struct AtlasData {
+        int pageWidth = 0;
+        std::vector<int> pageHeights;
+        std::vector<std::vector<unsigned char>> pages;
+        std::vector<AtlasEntry> entries;
+    };
+
+    bool PackAtlas(const std::vector<std::pair<std::string, std::string>>& images, int pageSize, AtlasData& outAtlas);
+    bool SaveAtlas(const AtlasData& atlas, const char* filepath);
+    bool ReadAtlas(const char* filepath, AtlasData& outAtlas);
+
+}
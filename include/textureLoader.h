@@ -0,0 +1,59 @@
+#pragma once
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ech {
+
+    // Decodes images with stb_image on a pool of worker threads. The render thread then uploads
+    // them through a pixel buffer object, only as many per frame as fit in the time budget.
+    class TextureLoader {
+    public:
+        struct Result {
+            uint64_t id;        // What Queue was called with
+            GLuint texture;     // 0 if decoding failed
+            int width, height;
+        };
+
+        void Start(int threadCount);
+        void Stop();            // Joins the workers and drops everything not uploaded yet
+        bool IsRunning() const { return !workers.empty(); }
+
+        void Queue(uint64_t id, const std::string& filepath);
+
+        // Render thread only. Uploads decoded images until budgetMs is spent (at least one per call)
+        // and calls onFinished for each of them, failed decodes included.
+        void Upload(double budgetMs, const std::function<void(const Result&)>& onFinished);
+
+    private:
+        struct Request {
+            uint64_t id;
+            std::string filepath;
+        };
+
+        struct Decoded {
+            uint64_t id;
+            unsigned char* pixels;  // RGBA, nullptr if stb_image failed
+            int width, height;
+        };
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        std::deque<Request> requests;
+        std::deque<Decoded> decoded;
+        bool stopping = false;
+
+        GLuint pixelBuffer = 0;
+
+        void WorkerLoop();
+        GLuint UploadImage(const Decoded& image);
+    };
+
+}
@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec4 Color; // Color of the shape
+in vec2 Local;
+in vec4 Shape;
+
+void main() {
+    if (Shape.x <= 0.0) {
+        FragColor = Color; // Plain shape, output the color as is
+        return;
+    }
+
+    // Signed distance to a rounded box, a circle is a box with the corner radius equal to its half size
+    vec2 q = abs(Local) - Shape.xy + Shape.z;
+    float dist = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - Shape.z;
+
+    if (Shape.w > 0.0) {
+        dist = abs(dist + Shape.w * 0.5) - Shape.w * 0.5; // Ring, keep only a band inside the outline
+    }
+
+    // One pixel wide edge at any radius and zoom
+    float coverage = clamp(0.5 - dist / max(fwidth(dist), 0.0001), 0.0, 1.0);
+    if (coverage <= 0.0) discard;
+
+    FragColor = vec4(Color.rgb, Color.a * coverage);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aLocal;   // Position relative to the shape center, only used by SDF shapes
+layout (location = 2) in vec4 aColor;   // Per vertex color so different shapes can share a draw call
+layout (location = 7) in vec4 aShape;   // Half width, half height, corner radius, ring thickness (0 for plain shapes)
+
+// Per instance attributes, only used by DrawRectangleInstanced (aPos is then the unit quad corner)
+layout (location = 3) in vec4 iRect;      // x, y, width, height in pixels
+layout (location = 5) in vec4 iColor;
+layout (location = 6) in float iRotation; // Degrees
+
+uniform bool uInstanced;
+uniform mat4 uViewProjection; // Camera, world pixels to clip space
+
+out vec4 Color;
+out vec2 Local;
+out vec4 Shape;
+
+void main() {
+    if (uInstanced) {
+        vec2 local = (aPos - 0.5) * iRect.zw;
+        float c = cos(radians(iRotation));
+        float s = sin(radians(iRotation));
+        vec2 pixel = iRect.xy + 0.5 * iRect.zw + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+        gl_Position = uViewProjection * vec4(pixel, 0.0, 1.0);
+        Color = iColor;
+        Local = vec2(0.0);
+        Shape = vec4(0.0);
+    }
+    else {
+        gl_Position = uViewProjection * vec4(aPos, 0.0, 1.0);
+        Color = aColor;
+        Local = aLocal;
+        Shape = aShape;
+    }
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+in vec4 TextColor;
+
+uniform sampler2D text; // Glyph coverage in the red channel
+
+void main()
+{
+    FragColor = vec4(TextColor.rgb, TextColor.a * texture(text, TexCoord).r);
+}
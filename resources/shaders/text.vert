@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aColor;
+out vec2 TexCoord;
+out vec4 TextColor;
+
+uniform mat4 uViewProjection; // Camera, world pixels to clip space
+
+void main()
+{
+    gl_Position = uViewProjection * vec4(aPos, 0.0, 1.0);
+    TexCoord = aTexCoord;
+    TextColor = aColor;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+in vec2 TexCoord;
+in vec4 TextColor;
+
+uniform sampler2D text; // Signed distance in the red channel, the glyph edge is at 0.5
+
+void main()
+{
+    // fwidth is how much the distance changes over one screen pixel, so the edge stays
+    // one pixel soft at any text size or camera zoom
+    float distance = texture(text, TexCoord).r;
+    float width = max(fwidth(distance), 0.0001);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+    FragColor = vec4(TextColor.rgb, TextColor.a * alpha);
+}
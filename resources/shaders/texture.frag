@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+in vec4 Tint;
+
+uniform sampler2D texture1; // The texture for rendering
+
+void main() {
+    vec4 texColor = texture(texture1, TexCoord);
+    if (texColor.a < 0.1) discard; // Discard transparent pixels
+    FragColor = texColor * Tint; // Output the texture color
+}
@@ -0,0 +1,35 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;       // Position of the vertex
+layout (location = 1) in vec2 aTexCoord;  // Texture coordinates
+layout (location = 2) in vec4 aColor;     // Tint, alpha is the transparency
+
+// Per instance attributes, only used by DrawTexturedInstanced (aPos is then the unit quad corner)
+layout (location = 3) in vec4 iRect;      // x, y, width, height in pixels
+layout (location = 4) in vec4 iUvRect;    // u0, v0 (top-left), u1, v1 (bottom-right)
+layout (location = 5) in vec4 iColor;
+layout (location = 6) in float iRotation; // Degrees
+
+uniform bool uInstanced;
+uniform mat4 uViewProjection; // Camera, world pixels to clip space
+uniform vec4 uUvRegion;       // Where the image is inside its texture (atlas page), instanced only
+
+out vec2 TexCoord;
+out vec4 Tint;
+
+void main() {
+    if (uInstanced) {
+        vec2 local = (aPos - 0.5) * iRect.zw;
+        float c = cos(radians(iRotation));
+        float s = sin(radians(iRotation));
+        vec2 pixel = iRect.xy + 0.5 * iRect.zw + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+        gl_Position = uViewProjection * vec4(pixel, 0.0, 1.0);
+        vec2 uv = vec2(mix(iUvRect.x, iUvRect.z, aPos.x), mix(iUvRect.w, iUvRect.y, aPos.y));
+        TexCoord = mix(uUvRegion.xy, uUvRegion.zw, uv);
+        Tint = iColor;
+    }
+    else {
+        gl_Position = uViewProjection * vec4(aPos, 0.0, 1.0);
+        TexCoord = aTexCoord;  // Pass texture coordinates to fragment shader
+        Tint = aColor;
+    }
+}
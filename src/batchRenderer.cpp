@@ -0,0 +1,515 @@
+#include "batchRenderer.h"
+#include "glState.h"
+#include "echlib.h"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace ech {
+
+    // Max quads per draw call, the index buffer is built once for this many quads
+    static const int MAX_BATCH_QUADS = 8192;
+    static const int MAX_BATCH_VERTICES = MAX_BATCH_QUADS * 4;
+
+    // Room for a few full batches per frame before the ring has to move to the next segment
+    static const size_t VERTEX_STREAM_SEGMENT_SIZE = 4 * 1024 * 1024;
+
+    static GLuint batchVao = 0;
+    static GLuint batchEbo = 0;
+    static StreamBuffer vertexStream;
+
+    static GLuint instanceVao = 0;
+    static GLuint unitQuadVbo = 0;
+
+    static BatchVertex batchVertices[MAX_BATCH_VERTICES];
+    static int batchQuadCount = 0;
+    static GLuint batchProgram = 0;
+    static GLuint batchTexture = 0;
+
+    static RenderStats frameStats = {};
+    static RenderStats lastFrameStats = {};
+
+    // Command buffer mode: quads wait here with a sort key until the next flush.
+    // Key bits: layer (63-56), program slot (55-48), texture slot (47-32), sequence (31-0).
+    // Slots are handed out in order of first use, the sequence is also the quad's index in commandVertices.
+    static bool commandBufferMode = false;
+    static thread_local uint64_t commandLayer = 0; // Per thread, draw lists record the layer of the thread filling them
+    static std::vector<uint64_t> commandKeys;
+    static std::vector<uint64_t> commandSortBuffer;
+    static std::vector<BatchVertex> commandVertices;
+    static std::vector<GLuint> commandPrograms;
+    static std::vector<GLuint> commandTextures;
+    static std::unordered_map<GLuint, uint32_t> commandTextureSlots;
+
+    static void AppendQuad(GLuint program, GLuint texture, const BatchVertex* vertices);
+    static void DrawBatch();
+
+    struct RecordedTextureSlot {
+        TextureRegion region;
+        uint32_t generation;
+        bool alive;
+    };
+
+    // Quads recorded by BatchQuad on a thread that is filling a draw list, replayed by SubmitDrawList
+    struct DrawListData {
+        struct Entry {
+            GLuint program;
+            GLuint texture;
+            uint64_t layer;
+        };
+
+        std::vector<Entry> entries;
+        std::vector<BatchVertex> vertices; // 4 per entry
+        int culled = 0;
+        int submitted = 0;
+        // Copied in BeginDrawList, the recording thread reads nothing else of the render thread
+        DrawState state;
+        std::vector<RecordedTextureSlot> textureSlots;
+    };
+
+    static thread_local DrawListData* recordingList = nullptr;
+
+    // Written by the render thread only, so it reads them without the lock. Workers copy them in BeginDrawList under the lock.
+    static DrawState drawState;
+    static std::vector<RecordedTextureSlot> publishedTextureSlots;
+    static std::mutex drawStateMutex;
+
+
+    void InitBatchRenderer() {
+        glGenVertexArrays(1, &batchVao);
+        glGenBuffers(1, &batchEbo);
+
+        BindVertexArray(batchVao);
+
+        // The attributes point at the start of the ring, each flush picks its vertices with a base vertex
+        vertexStream.Init(GL_ARRAY_BUFFER, VERTEX_STREAM_SEGMENT_SIZE);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexStream.GetBuffer());
+
+        // Every quad uses the same index pattern so the index buffer never changes
+        std::vector<GLuint> indices(MAX_BATCH_QUADS * 6);
+        for (int i = 0; i < MAX_BATCH_QUADS; i++) {
+            GLuint base = i * 4;
+            indices[i * 6 + 0] = base + 0;
+            indices[i * 6 + 1] = base + 1;
+            indices[i * 6 + 2] = base + 2;
+            indices[i * 6 + 3] = base + 2;
+            indices[i * 6 + 4] = base + 3;
+            indices[i * 6 + 5] = base + 0;
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchEbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, x));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, u));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, r));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(BatchVertex, halfWidth));
+        glEnableVertexAttribArray(7);
+
+        // Instanced quads: a static unit quad plus per instance attributes read from the stream buffer
+        float unitQuad[] = {
+            0.0f, 0.0f,
+            1.0f, 0.0f,
+            1.0f, 1.0f,
+            0.0f, 1.0f
+        };
+
+        glGenVertexArrays(1, &instanceVao);
+        glGenBuffers(1, &unitQuadVbo);
+        BindVertexArray(instanceVao);
+
+        glBindBuffer(GL_ARRAY_BUFFER, unitQuadVbo);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(unitQuad), unitQuad, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchEbo);
+
+        for (GLuint attribute = 3; attribute <= 6; attribute++) {
+            glEnableVertexAttribArray(attribute);
+            glVertexAttribDivisor(attribute, 1);
+        }
+
+        BindVertexArray(0);
+    }
+
+    void ShutdownBatchRenderer() {
+        vertexStream.Shutdown();
+        glDeleteBuffers(1, &batchEbo);
+        glDeleteBuffers(1, &unitQuadVbo);
+        glDeleteVertexArrays(1, &batchVao);
+        glDeleteVertexArrays(1, &instanceVao);
+        batchVao = batchEbo = unitQuadVbo = instanceVao = 0;
+        batchQuadCount = 0;
+    }
+
+    // LSD radix sort, one byte per pass. Keys are recorded in sequence order and every pass is stable,
+    // so only the state bytes above the sequence need sorting, and bytes that are the same in every key are skipped.
+    static void SortCommandKeys() {
+        size_t count = commandKeys.size();
+        commandSortBuffer.resize(count);
+
+        for (int shift = 32; shift < 64; shift += 8) {
+            size_t histogram[256] = {};
+            for (uint64_t key : commandKeys) {
+                histogram[(key >> shift) & 0xFF]++;
+            }
+            if (histogram[(commandKeys[0] >> shift) & 0xFF] == count) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t& bucket : histogram) {
+                size_t bucketSize = bucket;
+                bucket = offset;
+                offset += bucketSize;
+            }
+            for (uint64_t key : commandKeys) {
+                commandSortBuffer[histogram[(key >> shift) & 0xFF]++] = key;
+            }
+            commandKeys.swap(commandSortBuffer);
+        }
+    }
+
+    static void SubmitCommands() {
+        if (commandKeys.empty()) {
+            return;
+        }
+
+        SortCommandKeys();
+
+        for (uint64_t key : commandKeys) {
+            GLuint program = commandPrograms[(key >> 48) & 0xFF];
+            GLuint texture = commandTextures[(key >> 32) & 0xFFFF];
+            AppendQuad(program, texture, &commandVertices[(size_t)(key & 0xFFFFFFFF) * 4]);
+        }
+
+        commandKeys.clear();
+        commandVertices.clear();
+        commandPrograms.clear();
+        commandTextures.clear();
+        commandTextureSlots.clear();
+    }
+
+    static void RecordQuad(GLuint program, GLuint texture, uint64_t layer, const BatchVertex* vertices) {
+        uint32_t programSlot = 0;
+        while (programSlot < commandPrograms.size() && commandPrograms[programSlot] != program) {
+            programSlot++;
+        }
+
+        auto textureSlot = commandTextureSlots.find(texture);
+        bool newTexture = textureSlot == commandTextureSlots.end();
+
+        // Out of key bits for another program or texture, submit what is recorded and start over
+        if ((programSlot == commandPrograms.size() && programSlot > 0xFF) || (newTexture && commandTextures.size() > 0xFFFF)) {
+            FlushBatch();
+            RecordQuad(program, texture, layer, vertices);
+            return;
+        }
+
+        if (programSlot == commandPrograms.size()) {
+            commandPrograms.push_back(program);
+        }
+        if (newTexture) {
+            textureSlot = commandTextureSlots.emplace(texture, (uint32_t)commandTextures.size()).first;
+            commandTextures.push_back(texture);
+        }
+
+        uint64_t sequence = commandKeys.size();
+        commandKeys.push_back((layer << 56) | ((uint64_t)programSlot << 48) | ((uint64_t)textureSlot->second << 32) | sequence);
+        commandVertices.insert(commandVertices.end(), vertices, vertices + 4);
+    }
+
+    void FlushBatch() {
+        if (recordingList) {
+            std::cerr << "ERROR: Nothing can be flushed while this thread is filling a draw list" << std::endl;
+            return;
+        }
+        SubmitCommands();
+        DrawBatch();
+    }
+
+    // Only the quads already in the batch, AppendQuad calls this while commands are being submitted
+    static void DrawBatch() {
+        if (batchQuadCount == 0) {
+            return;
+        }
+
+        UseProgram(batchProgram);
+        if (batchTexture) {
+            BindTexture(batchTexture);
+        }
+
+        size_t size = batchQuadCount * 4 * sizeof(BatchVertex);
+        size_t offset = 0;
+        void* destination = vertexStream.Map(size, sizeof(BatchVertex), offset);
+        if (!destination) {
+            batchQuadCount = 0;
+            return;
+        }
+        memcpy(destination, batchVertices, size);
+        vertexStream.Unmap();
+
+        BindVertexArray(batchVao);
+        glDrawElementsBaseVertex(GL_TRIANGLES, batchQuadCount * 6, GL_UNSIGNED_INT, 0, (GLint)(offset / sizeof(BatchVertex)));
+
+        frameStats.drawCalls++;
+        batchQuadCount = 0;
+    }
+
+    void DrawInstancedQuads(GLuint program, GLuint texture, const float uvRegion[4], const QuadInstance* instances, size_t count) {
+        if (!instances || count == 0) {
+            return;
+        }
+
+        FlushBatch(); // Keep draw order
+
+        UseProgram(program);
+        glUniform1i(GetUniformLocation(program, "uInstanced"), 1);
+        glUniform4fv(GetUniformLocation(program, "uUvRegion"), 1, uvRegion);
+        if (texture) {
+            BindTexture(texture);
+        }
+
+        BindVertexArray(instanceVao);
+
+        size_t maxPerDraw = vertexStream.GetSegmentSize() / sizeof(QuadInstance) - 1;
+        while (count > 0) {
+            size_t drawCount = count < maxPerDraw ? count : maxPerDraw;
+            size_t size = drawCount * sizeof(QuadInstance);
+            size_t offset = 0;
+
+            void* destination = vertexStream.Map(size, sizeof(QuadInstance), offset);
+            if (!destination) {
+                break;
+            }
+            memcpy(destination, instances, size);
+            vertexStream.Unmap();
+
+            // No base instance in GL 3.3, so the instance attributes are pointed at this chunk instead
+            glBindBuffer(GL_ARRAY_BUFFER, vertexStream.GetBuffer());
+            const size_t stride = sizeof(QuadInstance);
+            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(QuadInstance, x)));
+            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(QuadInstance, u0)));
+            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(QuadInstance, color)));
+            glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(QuadInstance, rotation)));
+
+            glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, (GLsizei)drawCount);
+
+            frameStats.drawCalls++;
+            frameStats.quads += (int)drawCount;
+            instances += drawCount;
+            count -= drawCount;
+        }
+
+        glUniform1i(GetUniformLocation(program, "uInstanced"), 0);
+    }
+
+    void BatchQuad(GLuint program, GLuint texture, const BatchVertex* vertices) {
+        if (recordingList) {
+            recordingList->entries.push_back({ program, texture, commandLayer });
+            recordingList->vertices.insert(recordingList->vertices.end(), vertices, vertices + 4);
+            return;
+        }
+        if (commandBufferMode) {
+            RecordQuad(program, texture, commandLayer, vertices);
+            return;
+        }
+        AppendQuad(program, texture, vertices);
+    }
+
+    static void AppendQuad(GLuint program, GLuint texture, const BatchVertex* vertices) {
+        if (batchQuadCount > 0 && (program != batchProgram || texture != batchTexture)) {
+            DrawBatch();
+        }
+        if (batchQuadCount == MAX_BATCH_QUADS) {
+            DrawBatch();
+        }
+
+        batchProgram = program;
+        batchTexture = texture;
+
+        BatchVertex* dst = &batchVertices[batchQuadCount * 4];
+        dst[0] = vertices[0];
+        dst[1] = vertices[1];
+        dst[2] = vertices[2];
+        dst[3] = vertices[3];
+        batchQuadCount++;
+
+        frameStats.quads++;
+    }
+
+    void BatchTriangle(GLuint program, GLuint texture, const BatchVertex& a, const BatchVertex& b, const BatchVertex& c) {
+        // The second triangle of the quad (c, c, a) has no area so nothing extra gets rasterized
+        BatchVertex quad[4] = { a, b, c, c };
+        BatchQuad(program, texture, quad);
+    }
+
+    void BeginBatchFrame() {
+        batchQuadCount = 0;
+        commandKeys.clear();
+        commandVertices.clear();
+        commandPrograms.clear();
+        commandTextures.clear();
+        commandTextureSlots.clear();
+        frameStats = {};
+    }
+
+    void SetCommandBufferMode(bool enabled) {
+        FlushBatch(); // What was drawn before the switch keeps its place
+        commandBufferMode = enabled;
+    }
+
+    void SetDrawLayer(int layer) {
+        commandLayer = (uint64_t)(layer < 0 ? 0 : (layer > 255 ? 255 : layer));
+    }
+
+    void EndBatchFrame() {
+        FlushBatch();
+        vertexStream.NextSegment(); // The next frame writes where the GPU is not reading
+
+        frameStats.bytesStreamed = vertexStream.GetBytesStreamed();
+        vertexStream.ResetStats();
+        lastFrameStats = frameStats;
+    }
+
+    DrawList::DrawList() : data(new DrawListData()) {
+    }
+
+    // A moved-from list has no data, it acts as an empty list and BeginDrawList gives it new data
+    DrawList::~DrawList() = default;
+    DrawList::DrawList(DrawList&&) noexcept = default;
+    DrawList& DrawList::operator=(DrawList&&) noexcept = default;
+
+    void DrawList::Clear() {
+        if (!data) {
+            return;
+        }
+        data->entries.clear();
+        data->vertices.clear();
+        data->culled = 0;
+        data->submitted = 0;
+    }
+
+    size_t DrawList::GetQuadCount() const {
+        return data ? data->entries.size() : 0;
+    }
+
+    void BeginDrawList(DrawList& list) {
+        if (recordingList) {
+            std::cerr << "ERROR: This thread is already recording a draw list" << std::endl;
+            return;
+        }
+        if (!list.data) {
+            list.data.reset(new DrawListData());
+        }
+        list.Clear();
+        {
+            std::lock_guard<std::mutex> lock(drawStateMutex);
+            list.data->state = drawState;
+            list.data->textureSlots = publishedTextureSlots;
+        }
+        recordingList = list.data.get();
+    }
+
+    void EndDrawList(DrawList& list) {
+        if (!list.data || recordingList != list.data.get()) {
+            std::cerr << "ERROR: EndDrawList without a matching BeginDrawList on this thread" << std::endl;
+            return;
+        }
+        recordingList = nullptr;
+    }
+
+    void SubmitDrawList(const DrawList& list) {
+        if (!list.data) {
+            return;
+        }
+        const DrawListData& data = *list.data;
+        frameStats.culled += data.culled;
+        frameStats.submitted += data.submitted;
+
+        for (size_t i = 0; i < data.entries.size(); i++) {
+            const DrawListData::Entry& entry = data.entries[i];
+            if (commandBufferMode) {
+                RecordQuad(entry.program, entry.texture, entry.layer, &data.vertices[i * 4]);
+            }
+            else {
+                AppendQuad(entry.program, entry.texture, &data.vertices[i * 4]);
+            }
+        }
+    }
+
+    void CountCullResult(bool visible, int count) {
+        if (recordingList) {
+            (visible ? recordingList->submitted : recordingList->culled) += count;
+        }
+        else {
+            (visible ? frameStats.submitted : frameStats.culled) += count;
+        }
+    }
+
+    void SetDrawState(const DrawState& state) {
+        std::lock_guard<std::mutex> lock(drawStateMutex);
+        drawState = state;
+    }
+
+    const DrawState& GetDrawState() {
+        return recordingList ? recordingList->state : drawState;
+    }
+
+    void PublishTextureSlot(uint32_t index, uint32_t generation, const TextureRegion* region) {
+        std::lock_guard<std::mutex> lock(drawStateMutex);
+        if (index >= publishedTextureSlots.size()) {
+            publishedTextureSlots.resize((size_t)index + 1, { {}, 0, false });
+        }
+        publishedTextureSlots[index] = { region ? *region : TextureRegion{}, generation, region != nullptr };
+    }
+
+    const TextureRegion* GetRecordedTextureRegion(uint32_t index, uint32_t generation) {
+        if (!recordingList || index >= recordingList->textureSlots.size()) {
+            return nullptr;
+        }
+        const RecordedTextureSlot& slot = recordingList->textureSlots[index];
+        if (!slot.alive || slot.generation != generation) {
+            return nullptr;
+        }
+        return &slot.region;
+    }
+
+    bool IsRecordingDrawList() {
+        return recordingList != nullptr;
+    }
+
+    bool RejectWhileRecording(const char* function) {
+        if (!recordingList) {
+            return false;
+        }
+        std::cerr << "ERROR: " << function << " makes OpenGL calls, it can't be recorded into a draw list" << std::endl;
+        return true;
+    }
+
+    RenderStats& GetFrameStats() {
+        return frameStats;
+    }
+
+    GLuint GetQuadIndexBuffer() {
+        return batchEbo;
+    }
+
+    StreamBuffer& GetVertexStream() {
+        return vertexStream;
+    }
+
+    const RenderStats& GetRenderStats() {
+        return lastFrameStats;
+    }
+
+}
@@ -1,4 +1,15 @@
 #include "echlib.h"
+#include "batchRenderer.h"
+#include "glState.h"
+#include "textureAtlas.h"
+#include "textureLoader.h"
+#include "textRenderer.h"
+#include "glyphCache.h"
+#include "hash.h"
+#include "shaderBuilder.h"
+#include "shaderRegistry.h"
+#include "framePacer.h"
+#include "pngWriter.h"
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 #include <iostream>
@@ -9,18 +20,23 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <chrono>
+#include <cfloat>
+#include <cmath>
 #include <fstream>
 #include <stb_truetype/stb_truetype.h>
 #include <array>
 #include <cstdlib> // For malloc/free or new/delete
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
 
 
 namespace ech {
     GLFWwindow* window = nullptr;
-    unsigned int vao, vbo, ebo;
     unsigned int shaderProgramShape;
     unsigned int shaderProgramTexture;
     unsigned int shaderProgramText;
+    unsigned int shaderProgramTextSdf;
 
     GLuint defaultFont;
 
@@ -29,248 +45,121 @@ namespace ech {
 
     unsigned int textureID;
     std::unordered_map<std::string, GLuint> textures;
-
-    int targetFps;
+    std::unordered_map<std::string, TextureHandle> textureHandles;
+
+    // Slot array behind TextureHandle, unloaded slots are reused with the next generation
+    struct TextureSlot {
+        TextureRegion region;
+        std::string name;
+        uint32_t generation;
+        bool alive;
+        bool ownsTexture;   // false for atlas images, their page texture is shared
+    };
+
+    static std::vector<TextureSlot> textureSlots;
+    static std::vector<uint32_t> freeTextureSlots;
+
+    // Atlas pages are shared by their images, a page is deleted once the last image on it is unloaded
+    static std::unordered_map<GLuint, int> atlasPageUsers;
+
+    // Async loading, the slot shows the placeholder until the upload is done
+    struct PendingTexture {
+        TextureHandle handle;
+        std::string name;
+        TextureLoadedCallback onLoaded;
+    };
+
+    static TextureLoader textureLoader;
+    static std::unordered_map<uint64_t, PendingTexture> pendingTextures;
+    static uint64_t nextTextureRequest = 1;
+    static TextureLoadProgress textureLoadProgress = {};
+    static float textureUploadBudget = 2.0f;
+    static GLuint placeholderTexture = 0;
+
+    static void UploadLoadedTextures();
+
+    static bool vsyncEnabled = false;
+
+    // Headless mode draws into this framebuffer instead of the (hidden) window
+    static bool headless = false;
+    static GLuint headlessFramebuffer = 0;
+    static GLuint headlessColorBuffer = 0;
+
+    static RenderLayer* activeLayer = nullptr; // Between BeginRenderLayer and EndRenderLayer
+    static DrawState screenDrawState;          // Outside render layers, set by BuildFrameContext
+
+    // Bounds in any corner order, tested against the draw state of this thread (its draw list's copy while it fills one).
+    // Counts the result in the render stats.
+    static bool IsVisible(float x0, float y0, float x1, float y1) {
+        const DrawState& state = GetDrawState();
+        bool visible = std::max(x0, x1) >= state.cullMinX && std::min(x0, x1) <= state.cullMaxX &&
+            std::max(y0, y1) >= state.cullMinY && std::min(y0, y1) <= state.cullMaxY;
+        CountCullResult(visible);
+        return visible;
+    }
 
     using namespace std::chrono;
 
-    std::chrono::high_resolution_clock::time_point lastTime = std::chrono::high_resolution_clock::now();
+    static std::chrono::steady_clock::time_point firstFrameTime;
+    static std::chrono::steady_clock::time_point lastFrameTime;
+
+    static FixedUpdateCallback fixedUpdate;
+    static float fixedStep = 1.0f / 60.0f;
+    static int maxFixedSteps = 8;
+    static double fixedAccumulator = 0.0;
+    static float interpolationAlpha = 0.0f;
 
     int ech::windowWidth = 0;
     int ech::windowHeight = 0;
 
     float transparency = 1.0f;
 
-    std::unordered_map<int, bool> mouseButtonPreviousStates;
-
-
-
-
-    // Shape Vertex Shader
-    static const char* shapeVertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec2 aPos;
- 
-void main() {
-    gl_Position = vec4(aPos, 0.0, 1.0); // Directly using the vertex position
-}
-)";
-
-
-    // Shape Fragment Shader
-    static const char* shapeFragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-
-uniform vec4 uColor; // Color of the shape
-
-void main() {
-    FragColor = uColor; // Output the color of the shape
-}
-
-)";
-
-
-    // Texture Vertex Shader
-    static const char* textureVertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec2 aPos;       // Position of the vertex
-layout (location = 1) in vec2 aTexCoord;  // Texture coordinates
-
-out vec2 TexCoord;
-
-uniform mat4 projection; // Projection matrix for 2D rendering
-
-void main() {
-    gl_Position = projection * vec4(aPos, 0.0, 1.0); // Apply projection matrix
-    TexCoord = aTexCoord;  // Pass texture coordinates to fragment shader
-}
-
-)";
-
-
-    // Texture Fragment Shader
-    static const char* textureFragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-
-in vec2 TexCoord;
-
-uniform sampler2D texture1; // The texture for rendering
-
-void main() {
-    vec4 texColor = texture(texture1, TexCoord);
-    if (texColor.a < 0.1) discard; // Discard transparent pixels
-    FragColor = texColor; // Output the texture color
-}
-
-)";
-
-    // Vertex Shader Source for Text Rendering
-    const char* textVertexShaderSource = R"(
-#version 330 core
-layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec2 aTexCoord;
-out vec2 TexCoord;
-
-void main()
-{
-    gl_Position = vec4(aPos, 0.0, 1.0);
-    TexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y); // Flip texture
-}
-)";
-
-    // Fragment Shader Source for Text Rendering
-    const char* textFragmentShaderSource = R"(
-#version 330 core
-out vec4 FragColor;
-in vec2 TexCoord;
-
-uniform sampler2D text; // Texture for text rendering
-
-void main()
-{
-    FragColor = texture(text, TexCoord);
-}
-)";
-
-
-
-
-
-    // Compile shader
-    void CompileShader(unsigned int shader, const char* source, const std::string& shaderType) {
-        glShaderSource(shader, 1, &source, nullptr);
-        glCompileShader(shader);
-
-        int success;
-        char infoLog[512];
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-            std::cerr << "ERROR: " << shaderType << " Shader Compilation Failed\n" << infoLog << std::endl;
-        }
-    }
-
-
-    // Create text shader program
-    void CreateTextShaderProgram() {
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        CompileShader(vertexShader, textVertexShaderSource, "Vertex");
-
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        CompileShader(fragmentShader, textFragmentShaderSource, "Fragment");
-
-        shaderProgramText = glCreateProgram();
-        glAttachShader(shaderProgramText, vertexShader);
-        glAttachShader(shaderProgramText, fragmentShader);
-        glLinkProgram(shaderProgramText);
-
-        int success;
-        char infoLog[512];
-        glGetProgramiv(shaderProgramText, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shaderProgramText, 512, nullptr, infoLog);
-            std::cerr << "ERROR: Text Shader Program Linking Failed\n" << infoLog << std::endl;
-        }
-
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-    }
-
-
+    static FrameContext frameContext = {};
 
-    void CreateShapeShaderProgram() {
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        CompileShader(vertexShader, shapeVertexShaderSource, "Vertex");
+    // Updated by the GLFW callbacks, copied into the frame context by StartDrawing
+    static int framebufferWidth = 0;
+    static int framebufferHeight = 0;
+    static float contentScaleX = 1.0f;
+    static float contentScaleY = 1.0f;
 
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        CompileShader(fragmentShader, shapeFragmentShaderSource, "Fragment");
-
-        shaderProgramShape = glCreateProgram();
-        glAttachShader(shaderProgramShape, vertexShader);
-        glAttachShader(shaderProgramShape, fragmentShader);
-        glLinkProgram(shaderProgramShape);
-
-        int success;
-        char infoLog[512];
-        glGetProgramiv(shaderProgramShape, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shaderProgramShape, 512, nullptr, infoLog);
-            std::cerr << "ERROR: Shape Shader Program Linking Failed\n" << infoLog << std::endl;
-        }
-        else {
-            std::cout << "Shape Shader Program Linked Successfully!" << std::endl;
-        }
+    std::unordered_map<int, bool> mouseButtonPreviousStates;
 
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+    // The built-in programs are registered like any other, so editing their files reloads them too.
+    // Nothing can be drawn without them, false if any of them is missing or doesn't build.
+    static bool CreateShaderPrograms() {
+        bool text = LoadShaderProgram("text", RESOURCES_PATH "shaders/text.vert", RESOURCES_PATH "shaders/text.frag");
+        bool textSdf = LoadShaderProgram("text_sdf", RESOURCES_PATH "shaders/text.vert", RESOURCES_PATH "shaders/text_sdf.frag");
+        bool shape = LoadShaderProgram("shape", RESOURCES_PATH "shaders/shape.vert", RESOURCES_PATH "shaders/shape.frag");
+        bool texture = LoadShaderProgram("texture", RESOURCES_PATH "shaders/texture.vert", RESOURCES_PATH "shaders/texture.frag");
+        return text && textSdf && shape && texture;
     }
 
-    void CreateTextureShaderProgram() {
-        unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        CompileShader(vertexShader, textureVertexShaderSource, "Vertex");
-
-        unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        CompileShader(fragmentShader, textureFragmentShaderSource, "Fragment");
-
-        shaderProgramTexture = glCreateProgram();
-        glAttachShader(shaderProgramTexture, vertexShader);
-        glAttachShader(shaderProgramTexture, fragmentShader);
-        glLinkProgram(shaderProgramTexture);
-
-        int success;
-        char infoLog[512];
-        glGetProgramiv(shaderProgramTexture, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shaderProgramTexture, 512, nullptr, infoLog);
-            std::cerr << "ERROR: Shape Shader Program Linking Failed\n" << infoLog << std::endl;
-        }
-        else {
-            std::cout << "Shape Shader Program Linked Successfully!" << std::endl;
-        }
-
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+    // A reload replaces the program, so the handles are looked up again every frame
+    static void UpdateBuiltInPrograms() {
+        shaderProgramText = GetShaderProgram("text");
+        shaderProgramTextSdf = GetShaderProgram("text_sdf");
+        shaderProgramShape = GetShaderProgram("shape");
+        shaderProgramTexture = GetShaderProgram("texture");
     }
 
 
 
 
 
-    // Initialize OpenGL
-    void InitGraphics() {
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-        glGenBuffers(1, &ebo);
-        glBindVertexArray(vao);
-
-        float vertices[] = {
-            -0.5f, -0.5f, 0.0f, 0.0f,
-             0.5f, -0.5f, 1.0f, 0.0f,
-             0.0f,  0.5f, 0.5f, 1.0f
-        };
-
-        unsigned int indices[] = { 0, 1, 2 };
-
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
+    // Initialize OpenGL, false if the built-in shaders couldn't be built
+    static bool InitGraphics() {
+        InitBatchRenderer();
 
         glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // Alpha accumulates as coverage, so render layers (cleared to transparent) end up premultiplied
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
         glDisable(GL_DEPTH_TEST);
 
-        CreateTextShaderProgram();
-        CreateShapeShaderProgram();
-        CreateTextureShaderProgram();
+        if (!CreateShaderPrograms()) {
+            return false;
+        }
+        UpdateBuiltInPrograms();
+        return true;
     }
 
     void ech::MakeWindow(int width, int height, const char* title) {
@@ -282,6 +171,7 @@ void main()
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, headless ? GLFW_FALSE : GLFW_TRUE);
 
         window = glfwCreateWindow(width, height, title, nullptr, nullptr);
         if (!window) {
@@ -298,24 +188,156 @@ void main()
             return;
         }
 
-        windowWidth = width;
-        windowHeight = height;
-        glViewport(0, 0, width, height);
+        // Drivers pick their own default, the frame limiter only works right with it off
+        glfwSwapInterval(vsyncEnabled ? 1 : 0);
 
-        glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int w, int h) {
+        // Draw coordinates are in screen coordinates, on HiDPI screens the framebuffer is bigger than that
+        glfwGetWindowSize(window, &windowWidth, &windowHeight);
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        glfwGetWindowContentScale(window, &contentScaleX, &contentScaleY);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+
+        glfwSetWindowSizeCallback(window, [](GLFWwindow*, int w, int h) {
             ech::windowWidth = w;
             ech::windowHeight = h;
+            });
+
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow*, int w, int h) {
+            if (headless) {
+                return; // The offscreen framebuffer keeps its size
+            }
+            framebufferWidth = w;
+            framebufferHeight = h;
             glViewport(0, 0, w, h);
             });
 
-        InitGraphics();
+        glfwSetWindowContentScaleCallback(window, [](GLFWwindow*, float x, float y) {
+            if (headless) {
+                return;
+            }
+            contentScaleX = x;
+            contentScaleY = y;
+            });
+
+        if (!InitGraphics()) {
+            std::cerr << "ERROR: Failed to build the built-in shaders, check that " RESOURCES_PATH "shaders/ ships with the executable" << std::endl;
+            ShutdownShaderRegistry();
+            ShutdownBatchRenderer();
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            window = nullptr;
+            return;
+        }
     }
 
-    void ech::SetTargetFps(int target) {
-        targetFps = target;
+    // Hidden window for the context, the frames go into a framebuffer that doesn't depend on any screen
+    void ech::MakeHeadlessWindow(int width, int height) {
+        headless = true;
+        MakeWindow(width, height, "Echlib (headless)");
+        if (!window) {
+            headless = false;
+            return;
+        }
+
+        glGenRenderbuffers(1, &headlessColorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, headlessColorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenFramebuffers(1, &headlessFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, headlessFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessColorBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "ERROR: Headless framebuffer is incomplete" << std::endl;
+        }
+
+        windowWidth = width;
+        windowHeight = height;
+        framebufferWidth = width;
+        framebufferHeight = height;
+        contentScaleX = 1.0f;
+        contentScaleY = 1.0f;
+        glViewport(0, 0, width, height);
+    }
+
+    bool ech::IsHeadless() {
+        return headless;
+    }
+
+    bool ech::ReadPixels(std::vector<unsigned char>& outPixels, int& outWidth, int& outHeight) {
+        if (!window) {
+            return false;
+        }
+
+        FlushBatch();
+
+        outWidth = framebufferWidth;
+        outHeight = framebufferHeight;
+        size_t rowSize = (size_t)outWidth * 4;
+        outPixels.resize(rowSize * outHeight);
+
+        // The read buffer belongs to the framebuffer it is set on, both are put back afterwards
+        GLint previousReadFramebuffer = 0;
+        GLint previousReadBuffer = 0;
+        GLint previousPackAlignment = 4;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+        glGetIntegerv(GL_PACK_ALIGNMENT, &previousPackAlignment);
+
+        GLuint readFramebuffer = headless ? headlessFramebuffer : 0;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+        glGetIntegerv(GL_READ_BUFFER, &previousReadBuffer);
+        if (headless) {
+            glReadBuffer(GL_COLOR_ATTACHMENT0);
+        }
+        else {
+            glReadBuffer(GL_FRONT); // The back buffer is undefined after the swap
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, outWidth, outHeight, GL_RGBA, GL_UNSIGNED_BYTE, outPixels.data());
+
+        glReadBuffer((GLenum)previousReadBuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)previousReadFramebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, previousPackAlignment);
+
+        // OpenGL returns the bottom row first
+        std::vector<unsigned char> row(rowSize);
+        for (int y = 0; y < outHeight / 2; y++) {
+            unsigned char* top = outPixels.data() + y * rowSize;
+            unsigned char* bottom = outPixels.data() + (outHeight - 1 - y) * rowSize;
+            memcpy(row.data(), top, rowSize);
+            memcpy(top, bottom, rowSize);
+            memcpy(bottom, row.data(), rowSize);
+        }
+        return true;
+    }
+
+    bool ech::SaveScreenshot(const char* filepath) {
+        std::vector<unsigned char> pixels;
+        int width, height;
+        if (!ReadPixels(pixels, width, height)) {
+            return false;
+        }
+        return WritePng(filepath, pixels.data(), width, height);
+    }
+
+    void ech::SetVsync(bool enabled) {
+        vsyncEnabled = enabled;
+        if (window) {
+            glfwSwapInterval(enabled ? 1 : 0);
+        }
     }
 
     void ech::CloseWindow() {
+        textureLoader.Stop();
+        pendingTextures.clear();
+        if (headless) {
+            glDeleteFramebuffers(1, &headlessFramebuffer);
+            glDeleteRenderbuffers(1, &headlessColorBuffer);
+            headlessFramebuffer = 0;
+            headlessColorBuffer = 0;
+            headless = false;
+        }
+        ShutdownShaderRegistry();
+        ShutdownBatchRenderer();
         glfwDestroyWindow(window);
         glfwTerminate();
     }
@@ -324,15 +346,115 @@ void main()
         return glfwWindowShouldClose(window);
     }
 
+    // Window framebuffer, or the offscreen one in headless mode
+    static void BindScreenFramebuffer() {
+        glBindFramebuffer(GL_FRAMEBUFFER, headless ? headlessFramebuffer : 0);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+    }
+
+    // Fills the frame context from the cached window state and hands the camera matrix to every program
+    static void BuildFrameContext() {
+        frameContext.windowWidth = ech::windowWidth;
+        frameContext.windowHeight = ech::windowHeight;
+        frameContext.framebufferWidth = framebufferWidth;
+        frameContext.framebufferHeight = framebufferHeight;
+        frameContext.contentScaleX = contentScaleX;
+        frameContext.contentScaleY = contentScaleY;
+        frameContext.frameIndex++;
+
+        float width = (float)frameContext.windowWidth;
+        float height = (float)frameContext.windowHeight;
+        glm::vec3 screenCenter(width / 2.0f, height / 2.0f, 0.0f);
+
+        // Zoom and rotation happen around the middle of the screen, the default camera is the identity
+        glm::mat4 view(1.0f);
+        view = glm::translate(view, screenCenter);
+        view = glm::scale(view, glm::vec3(camera.zoom, camera.zoom, 1.0f));
+        view = glm::rotate(view, glm::radians(-camera.rotation), glm::vec3(0.0f, 0.0f, 1.0f));
+        view = glm::translate(view, -screenCenter - glm::vec3(camera.x, camera.y, 0.0f));
+
+        glm::mat4 projection = glm::ortho(0.0f, width, 0.0f, height);
+        frameContext.viewProjection = projection * view;
+
+        // Screen corners back into the world, rotation makes the visible area a rotated rectangle so keep its bounds
+        glm::mat4 inverse = glm::inverse(frameContext.viewProjection);
+        glm::vec2 viewMin(FLT_MAX), viewMax(-FLT_MAX);
+        for (glm::vec2 corner : { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) }) {
+            glm::vec4 world = inverse * glm::vec4(corner, 0.0f, 1.0f);
+            viewMin = glm::min(viewMin, glm::vec2(world));
+            viewMax = glm::max(viewMax, glm::vec2(world));
+        }
+        frameContext.viewMinX = viewMin.x;
+        frameContext.viewMinY = viewMin.y;
+        frameContext.viewMaxX = viewMax.x;
+        frameContext.viewMaxY = viewMax.y;
+        screenDrawState = { viewMin.x, viewMin.y, viewMax.x, viewMax.y, height, camera.zoom, shaderProgramShape, shaderProgramTexture };
+        SetDrawState(screenDrawState);
+
+        SetRegistryViewProjection(frameContext.viewProjection);
+    }
+
+    const FrameContext& GetFrameContext() {
+        return frameContext;
+    }
+
+    // The one clock read of the frame, everything that needs a delta gets it from the frame context
+    static void AdvanceFrameTime() {
+        auto now = std::chrono::steady_clock::now();
+        if (frameContext.frameIndex == 0) {
+            firstFrameTime = now;
+            lastFrameTime = now;
+        }
+
+        frameContext.deltaTime = std::chrono::duration<float>(now - lastFrameTime).count();
+        frameContext.time = std::chrono::duration<double>(now - firstFrameTime).count();
+        lastFrameTime = now;
+    }
+
+    static void RunFixedUpdates() {
+        if (!fixedUpdate) {
+            return;
+        }
+
+        // Accumulated in double so the leftover doesn't drift over a long session
+        fixedAccumulator += frameContext.deltaTime;
+
+        int steps = 0;
+        while (fixedAccumulator >= fixedStep && steps < maxFixedSteps) {
+            fixedUpdate(fixedStep);
+            fixedAccumulator -= fixedStep;
+            steps++;
+        }
+
+        // Still behind after the maximum, drop the backlog but keep the fraction for interpolation
+        if (fixedAccumulator >= fixedStep) {
+            fixedAccumulator = std::fmod(fixedAccumulator, (double)fixedStep);
+        }
+
+        interpolationAlpha = (float)(fixedAccumulator / fixedStep);
+    }
+
     // Start drawing
     void ech::StartDrawing() {
+        BindScreenFramebuffer();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        UpdateShaderRegistry(); // Between frames, nothing is batched with an old program
+        UpdateBuiltInPrograms();
+        AdvanceFrameTime();
+        RunFixedUpdates();      // Before the frame context, so camera moves show up this frame
+        BeginBatchFrame();
+        BuildFrameContext();
+        UploadLoadedTextures();
     }
 
 
     // End drawing
     void ech::EndDrawing() {
-        glfwSwapBuffers(window);
+        EndBatchFrame(); // Submit whatever is still batched
+        if (!headless) {
+            glfwSwapBuffers(window);
+        }
+        PaceFrame(!vsyncEnabled); // Before polling, so the next frame sees input from after the wait
         glfwPollEvents();
     }
 
@@ -345,422 +467,647 @@ void main()
     }
 
 
-    void ech::DrawTriangle(float x, float y, float width, float height, const Color& color) {
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    // Builds a batch vertex, positions stay in world pixels (origin bottom-left) and the shader applies the camera
+    static BatchVertex WorldVertex(float x, float y, float u, float v, const Color& color, float alpha) {
+        return BatchVertex{ x, y, u, v, color.r, color.g, color.b, alpha, 0, 0, 0, 0 };
+    }
 
-        float flippedY = windowHeight - y;
+    // One quad around a circle / rounded rectangle / ring, the fragment shader cuts the shape out with its signed distance
+    static void BatchSdfShape(float centerX, float centerY, float halfWidth, float halfHeight, float cornerRadius, float thickness, const Color& color, float alpha) {
+        if (halfWidth <= 0.0f || halfHeight <= 0.0f) {
+            return;
+        }
 
-        float vertices[] = {
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width / 2) / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f
-        };
+        // Leave room for the anti-aliased edge, it is a pixel wide on screen so it grows when zoomed out
+        float padding = 1.0f / std::max(GetDrawState().cameraZoom, 0.01f);
+        float extentX = halfWidth + padding;
+        float extentY = halfHeight + padding;
+        if (!IsVisible(centerX - extentX, centerY - extentY, centerX + extentX, centerY + extentY)) {
+            return;
+        }
+        cornerRadius = std::min(cornerRadius, std::min(halfWidth, halfHeight));
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        float corners[4][2] = {
+            { -extentX, -extentY },
+            {  extentX, -extentY },
+            {  extentX,  extentY },
+            { -extentX,  extentY }
+        };
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        BatchVertex vertices[4];
+        for (int i = 0; i < 4; i++) {
+            vertices[i] = BatchVertex{
+                centerX + corners[i][0], centerY + corners[i][1],
+                corners[i][0], corners[i][1],
+                color.r, color.g, color.b, alpha,
+                halfWidth, halfHeight, cornerRadius, thickness
+            };
+        }
 
-        glUseProgram(shaderProgramShape);
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
+        BatchQuad(GetDrawState().shapeProgram, 0, vertices);
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, 3);
 
-        glBindVertexArray(0);
+    void ech::DrawTriangle(float x, float y, float width, float height, const Color& color) {
+        DrawProTriangle(x, y, width, height, color, color.a);
     }
 
     void ech::DrawRectangle(float x, float y, float width, float height, const Color& color) {
-        glUseProgram(shaderProgramShape);  // Use the shader for solid color shapes
+        if (!IsVisible(x, y, x + width, y + height)) {
+            return;
+        }
 
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+        BatchVertex vertices[4] = {
+            WorldVertex(x, y, 0, 0, color, color.a),                    // Bottom-left
+            WorldVertex(x + width, y, 0, 0, color, color.a),            // Bottom-right
+            WorldVertex(x + width, y + height, 0, 0, color, color.a),   // Top-right
+            WorldVertex(x, y + height, 0, 0, color, color.a)            // Top-left
+        };
 
-        float flippedY = windowHeight - y;  // Flip Y to match OpenGL coordinates
+        BatchQuad(GetDrawState().shapeProgram, 0, vertices);
+    }
 
-        // Define vertices consistently with DrawTexturedRectangle
-        float vertices[] = {
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,         // Bottom-left
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f, // Bottom-right
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f, // Top-right
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f  // Top-left
-        };
+    void DrawProRectangle(float x, float y, float width, float height, const Color& color, float angle, float transperency = 1.0f) {
+        // Rotate around the center of the rectangle, in pixels so the aspect ratio doesn't skew it
+        float centerX = x + width / 2.0f;
+        float centerY = y + height / 2.0f;
+
+        // Any rotation stays inside the circle through the corners
+        float radius = 0.5f * std::sqrt(width * width + height * height);
+        if (!IsVisible(centerX - radius, centerY - radius, centerX + radius, centerY + radius)) {
+            return;
+        }
 
-        unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };  // Two triangles for the rectangle
+        float cosTheta = cos(glm::radians(angle));
+        float sinTheta = sin(glm::radians(angle));
 
-        // Set color uniform
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
+        float corners[4][2] = {
+            { -width / 2.0f, -height / 2.0f },
+            {  width / 2.0f, -height / 2.0f },
+            {  width / 2.0f,  height / 2.0f },
+            { -width / 2.0f,  height / 2.0f }
+        };
 
-        // Bind buffers
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        BatchVertex vertices[4];
+        for (int i = 0; i < 4; i++) {
+            float rx = corners[i][0] * cosTheta - corners[i][1] * sinTheta;
+            float ry = corners[i][0] * sinTheta + corners[i][1] * cosTheta;
+            vertices[i] = WorldVertex(centerX + rx, centerY + ry, 0, 0, color, transperency);
+        }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+        BatchQuad(GetDrawState().shapeProgram, 0, vertices);
+    }
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    void ech::DrawCircle(float centerX, float centerY, float radius, const Color& color, int segments) {
+        DrawProCircle(centerX, centerY, radius, color, segments, color.a);
+    }
 
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);  // Draw the rectangle
 
-        glBindVertexArray(0);  // Unbind VAO
+    void ech::DrawProCircle(float centerX, float centerY, float radius, const Color& color, int /*segments*/, float transperency = 1.0f) {
+        // segments is kept for compatibility, the circle is exact at any radius now
+        BatchSdfShape(centerX, centerY, radius, radius, radius, 0.0f, color, transperency);
     }
 
-    void DrawProRectangle(float x, float y, float width, float height, const Color& color, float angle, float transperency = 1.0f) {
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    void DrawRing(float centerX, float centerY, float radius, float thickness, const Color& color) {
+        BatchSdfShape(centerX, centerY, radius, radius, radius, thickness, color, color.a);
+    }
 
+    void DrawRoundedRectangle(float x, float y, float width, float height, float cornerRadius, const Color& color) {
+        BatchSdfShape(x + width / 2.0f, y + height / 2.0f, width / 2.0f, height / 2.0f, cornerRadius, 0.0f, color, color.a);
+    }
 
-        float normalizedX = (x / (float)windowWidth) * 2.0f - 1.0f;
-        float normalizedY = (y / (float)windowHeight) * 2.0f - 1.0f;
-        float normalizedWidth = (width / (float)windowWidth) * 2.0f;
-        float normalizedHeight = (height / (float)windowHeight) * 2.0f;
+    void DrawRoundedRectangleOutline(float x, float y, float width, float height, float cornerRadius, float thickness, const Color& color) {
+        BatchSdfShape(x + width / 2.0f, y + height / 2.0f, width / 2.0f, height / 2.0f, cornerRadius, thickness, color, color.a);
+    }
 
-        // Flip the Y coordinate to match OpenGL's coordinate system
-        float flippedY = windowHeight - y;
+    void ech::DrawProTriangle(float x, float y, float width, float height, const Color& color, float transparency) {
+        if (!IsVisible(x, y, x + width, y + height)) {
+            return;
+        }
 
-        // Define the rectangle's original vertices (without rotation)
-        float vertices[] = {
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f,
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f
-        };
+        BatchTriangle(GetDrawState().shapeProgram, 0,
+            WorldVertex(x, y, 0, 0, color, transparency),
+            WorldVertex(x + width, y, 0, 0, color, transparency),
+            WorldVertex(x + width / 2, y + height, 0, 0, color, transparency));
+    }
 
-        // Calculate the center of the rectangle for rotation
-        float centerX = x + width / 2.0f;
-        float centerY = y + height / 2.0f;
 
-        // Normalize the center to NDC (OpenGL coordinates)
-        centerX = (centerX / windowWidth) * 2.0f - 1.0f;
-        centerY = 1.0f - ((windowHeight - centerY) / windowHeight) * 2.0f;
 
-        // Apply the rotation and translation to each vertex
-        glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
+    // Texture System
 
-        for (int i = 0; i < 8; i += 2) {
-            // Translate the vertex to the origin (subtract center), apply rotation, then translate back
-            glm::vec4 vertex(vertices[i], vertices[i + 1], 0.0f, 1.0f);
+    static TextureHandle CreateTextureSlot(const std::string& name, const TextureRegion& region, bool ownsTexture) {
+        // Loading a name again replaces the old texture, handles to it become stale
+        auto existing = textureHandles.find(name);
+        if (existing != textureHandles.end()) {
+            UnloadTexture(existing->second);
+        }
 
-            // Translate vertex to origin
-            vertex.x -= centerX;
-            vertex.y -= centerY;
+        uint32_t index;
+        if (!freeTextureSlots.empty()) {
+            index = freeTextureSlots.back();
+            freeTextureSlots.pop_back();
+        }
+        else {
+            index = (uint32_t)textureSlots.size();
+            textureSlots.push_back({});
+            textureSlots[index].generation = 1;
+        }
 
-            // Apply rotation
-            vertex = rotation * vertex;
+        TextureSlot& slot = textureSlots[index];
+        slot.region = region;
+        slot.name = name;
+        slot.alive = true;
+        slot.ownsTexture = ownsTexture;
+        PublishTextureSlot(index, slot.generation, &slot.region);
 
-            // Translate vertex back to original position
-            vertex.x += centerX;
-            vertex.y += centerY;
+        TextureHandle handle;
+        handle.index = index;
+        handle.generation = slot.generation;
 
-            // Store the transformed vertices
-            vertices[i] = vertex.x;
-            vertices[i + 1] = vertex.y;
+        textureHandles[name] = handle;
+        textures[name] = region.textureID;
+        return handle;
+    }
 
-            // Debugging: Print the transformed vertices
-            std::cout << "Transformed vertex " << i / 2 << ": (" << vertices[i] << ", " << vertices[i + 1] << ")" << std::endl;
+    TextureHandle GetTextureHandle(const std::string& name) {
+        // The name table isn't copied into draw lists, so workers have to get their handles beforehand
+        if (IsRecordingDrawList()) {
+            std::cerr << "ERROR: Texture names can't be looked up while filling a draw list, use a TextureHandle: " << name << std::endl;
+            return TextureHandle();
         }
 
-        // Use the color shader
-        glUseProgram(shaderProgramShape);
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, transperency);
+        auto handle = textureHandles.find(name);
+        if (handle == textureHandles.end()) {
+            return TextureHandle();
+        }
+        return handle->second;
+    }
 
-        // Bind buffers and draw the rotated rectangle
-        unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
+    const TextureRegion* GetTextureRegion(TextureHandle texture) {
+        if (IsRecordingDrawList()) {
+            return GetRecordedTextureRegion(texture.index, texture.generation);
+        }
+        if (texture.index >= textureSlots.size()) {
+            return nullptr;
+        }
+        const TextureSlot& slot = textureSlots[texture.index];
+        if (!slot.alive || slot.generation != texture.generation) {
+            return nullptr;
+        }
+        return &slot.region;
+    }
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+    void UnloadTexture(TextureHandle texture) {
+        if (!GetTextureRegion(texture)) {
+            return;
+        }
+        TextureSlot& slot = textureSlots[texture.index];
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        if (slot.ownsTexture) {
+            FlushBatch(); // Quads waiting in the batch may still use it
+            DeleteTexture(slot.region.textureID);
+        }
+        else {
+            auto page = atlasPageUsers.find(slot.region.textureID);
+            if (page != atlasPageUsers.end() && --page->second == 0) {
+                FlushBatch();
+                DeleteTexture(page->first);
+                atlasPageUsers.erase(page);
+            }
+        }
 
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        textureHandles.erase(slot.name);
+        textures.erase(slot.name);
 
-        glBindVertexArray(0); // Unbind VAO
+        slot.alive = false;
+        slot.name.clear();
+        slot.generation++;
+        if (slot.generation == 0) {
+            slot.generation = 1; // 0 marks invalid handles
+        }
+        PublishTextureSlot(texture.index, slot.generation, nullptr);
+        freeTextureSlots.push_back(texture.index);
     }
 
-    void ech::DrawCircle(float centerX, float centerY, float radius, const Color& color, int segments) {
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    static void CreatePlaceholderTexture() {
+        // 2x2 magenta and black checker, hard to miss if a texture never finishes loading
+        const unsigned char pixels[16] = {
+            255, 0, 255, 255,   0, 0, 0, 255,
+            0, 0, 0, 255,       255, 0, 255, 255
+        };
 
-        float aspectRatio = (float)windowWidth / (float)windowHeight;
+        glGenTextures(1, &placeholderTexture);
+        BindTexture(placeholderTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
 
-        // Normalize positions
-        float normalizedX = (centerX / (float)windowWidth) * 2.0f - 1.0f;
-        float normalizedY = (centerY / (float)windowHeight) * 2.0f - 1.0f;
+    TextureHandle LoadTextureAsync(const char* filepath, const std::string& name, TextureLoadedCallback onLoaded) {
+        if (!textureLoader.IsRunning()) {
+            // Leave one core for the render thread
+            int threads = (int)std::thread::hardware_concurrency() - 1;
+            textureLoader.Start(std::max(threads, 1));
+        }
+        if (!placeholderTexture) {
+            CreatePlaceholderTexture();
+        }
 
-        // Adjust X-axis for aspect ratio
-        normalizedX *= aspectRatio;
+        // A new wave of loads (the next level) starts counting from zero again
+        if (pendingTextures.empty()) {
+            textureLoadProgress = {};
+        }
 
-        // Flip the Y coordinate to match OpenGL's coordinate system
-        float flippedY = windowHeight - centerY;
+        TextureHandle handle = CreateTextureSlot(name, { placeholderTexture, 0.0f, 0.0f, 1.0f, 1.0f, 0, 0 }, false);
 
-        // Flip the Y coordinate to match OpenGL's coordinate system
-        segments = 36;
+        uint64_t id = nextTextureRequest++;
+        pendingTextures[id] = { handle, name, std::move(onLoaded) };
+        textureLoadProgress.requested++;
+        textureLoader.Queue(id, filepath);
+        return handle;
+    }
 
-        // Calculate the vertices for the circle using polar coordinates
-        std::vector<float> vertices;
-        for (int i = 0; i < segments; ++i) {
-            float theta = (i / float(segments)) * 2.0f * glm::pi<float>();
-            float x = centerX + radius * cos(theta);
-            float y = flippedY - radius * sin(theta); // Flip y-axis for OpenGL coordinates
-            vertices.push_back((x / windowWidth) * 2.0f - 1.0f); // Convert to NDC
-            vertices.push_back(1.0f - (y / windowHeight) * 2.0f); // Convert to NDC
+    static void FinishTextureLoad(const TextureLoader::Result& result) {
+        auto pending = pendingTextures.find(result.id);
+        if (pending == pendingTextures.end()) {
+            DeleteTexture(result.texture);
+            return;
         }
+        PendingTexture request = std::move(pending->second);
+        pendingTextures.erase(pending);
 
-        // Use the color shader
-        glUseProgram(shaderProgramShape);
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
-
-        // Create an index array for the circle (fan)
-        std::vector<unsigned int> indices;
-        for (int i = 1; i < segments - 1; ++i) {
-            indices.push_back(0);
-            indices.push_back(i);
-            indices.push_back(i + 1);
+        bool success = result.texture != 0;
+        if (success) {
+            textureLoadProgress.loaded++;
+        }
+        else {
+            textureLoadProgress.failed++;
         }
 
-        // Set up the vertex data
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
+        if (!GetTextureRegion(request.handle)) {
+            // Unloaded or replaced while it was loading, nobody can draw it anymore
+            if (success) {
+                DeleteTexture(result.texture);
+            }
+            success = false;
+        }
+        else if (success) {
+            TextureSlot& slot = textureSlots[request.handle.index];
+            slot.region = { result.texture, 0.0f, 0.0f, 1.0f, 1.0f, result.width, result.height };
+            slot.ownsTexture = true;
+            PublishTextureSlot(request.handle.index, slot.generation, &slot.region);
+            textures[request.name] = result.texture;
+            std::cout << "Texture loaded: " << request.name << std::endl;
+        }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+        if (request.onLoaded) {
+            request.onLoaded(request.name, request.handle, success);
+        }
+    }
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    static void UploadLoadedTextures() {
+        if (pendingTextures.empty()) {
+            return;
+        }
+        textureLoader.Upload(textureUploadBudget, FinishTextureLoad);
+    }
 
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+    TextureLoadProgress GetTextureLoadProgress() {
+        return textureLoadProgress;
+    }
 
-        glBindVertexArray(0); // Unbind VAO
+    void SetTextureUploadBudget(float milliseconds) {
+        textureUploadBudget = milliseconds;
     }
 
+    TextureHandle LoadTexture(const char* filepath, const std::string& name) {
+        TextureHandle handle;
 
-    void ech::DrawProCircle(float centerX, float centerY, float radius, const Color& color, int segments, float transperency = 1.0f) {
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+        glGenTextures(1, &textureID);
+        BindTexture(textureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
-        float aspectRatio = (float)windowWidth / (float)windowHeight;
 
-        // Normalize positions
-        float normalizedX = (centerX / (float)windowWidth) * 2.0f - 1.0f;
-        float normalizedY = (centerY / (float)windowHeight) * 2.0f - 1.0f;
+        int width, height, nrChannels;
+        unsigned char* data = stbi_load(filepath, &width, &height, &nrChannels, 0);
+        if (data) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, nrChannels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, data);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            handle = CreateTextureSlot(name, { textureID, 0.0f, 0.0f, 1.0f, 1.0f, width, height }, true);
+            std::cout << "Texture loaded: " << name << std::endl;
+        }
+        else {
+            std::cerr << "ERROR: Failed to load texture: " << filepath << std::endl;
+            DeleteTexture(textureID);
+        }
+        stbi_image_free(data);
+        return handle;
+    }
 
-        // Adjust X-axis for aspect ratio
-        normalizedX *= aspectRatio;
 
-        // Flip the Y coordinate to match OpenGL's coordinate system
-        float flippedY = windowHeight - centerY;
+    bool BuildTextureAtlas(const std::vector<std::pair<std::string, std::string>>& images, const char* atlasFile, int pageSize) {
+        AtlasData atlas;
+        if (!PackAtlas(images, pageSize, atlas)) {
+            std::cerr << "ERROR: Nothing could be packed into the atlas: " << atlasFile << std::endl;
+            return false;
+        }
 
-        // Flip the Y coordinate to match OpenGL's coordinate system
-        segments = 36;
+        std::cout << "Atlas packed: " << atlas.entries.size() << " images on " << atlas.pages.size() << " pages" << std::endl;
+        return SaveAtlas(atlas, atlasFile);
+    }
 
-        // Calculate the vertices for the circle using polar coordinates
-        std::vector<float> vertices;
-        for (int i = 0; i < segments; ++i) {
-            float theta = (i / float(segments)) * 2.0f * glm::pi<float>();
-            float x = centerX + radius * cos(theta);
-            float y = flippedY - radius * sin(theta); // Flip y-axis for OpenGL coordinates
-            vertices.push_back((x / windowWidth) * 2.0f - 1.0f); // Convert to NDC
-            vertices.push_back(1.0f - (y / windowHeight) * 2.0f); // Convert to NDC
+    bool LoadTextureAtlas(const char* atlasFile) {
+        AtlasData atlas;
+        if (!ReadAtlas(atlasFile, atlas)) {
+            return false;
         }
 
-        // Use the color shader
-        glUseProgram(shaderProgramShape);
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, transperency);
+        std::vector<GLuint> pageTextures(atlas.pages.size());
+        glGenTextures((GLsizei)pageTextures.size(), pageTextures.data());
 
-        // Create an index array for the circle (fan)
-        std::vector<unsigned int> indices;
-        for (int i = 1; i < segments - 1; ++i) {
-            indices.push_back(0);
-            indices.push_back(i);
-            indices.push_back(i + 1);
+        for (size_t i = 0; i < atlas.pages.size(); i++) {
+            BindTexture(pageTextures[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, atlas.pageWidth, atlas.pageHeights[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.pages[i].data());
         }
 
-        // Set up the vertex data
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
+        // Counted before any slot is created, loading the same atlas again unloads the old images (and pages) on the way
+        for (const AtlasEntry& entry : atlas.entries) {
+            atlasPageUsers[pageTextures[entry.page]]++;
+        }
+        for (GLuint page : pageTextures) {
+            if (atlasPageUsers.find(page) == atlasPageUsers.end()) {
+                DeleteTexture(page);
+            }
+        }
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        for (const AtlasEntry& entry : atlas.entries) {
+            float pageWidth = (float)atlas.pageWidth;
+            float pageHeight = (float)atlas.pageHeights[entry.page];
 
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+            TextureRegion region = {
+                pageTextures[entry.page],
+                entry.x / pageWidth, entry.y / pageHeight,
+                (entry.x + entry.width) / pageWidth, (entry.y + entry.height) / pageHeight,
+                entry.width, entry.height
+            };
+            CreateTextureSlot(entry.name, region, false);
+        }
 
-        glBindVertexArray(0); // Unbind VAO
+        std::cout << "Atlas loaded: " << atlasFile << " (" << atlas.entries.size() << " images)" << std::endl;
+        return true;
     }
 
-    void ech::DrawProTriangle(float x, float y, float width, float height, const Color& color, float transparency) {
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
 
-        float flippedY = windowHeight - y;
+    // The string versions only turn the name into a handle
+    void DrawTexturedRectangle(float x, float y, float width, float height, const std::string& name) {
+        TextureHandle texture = GetTextureHandle(name);
+        if (!texture.IsValid()) {
+            printf("Texture not found: %s\n", name.c_str());
+            return;
+        }
+        DrawTexturedRectangle(x, y, width, height, texture);
+    }
 
-        float vertices[] = {
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width / 2) / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f
-        };
+    void DrawTexturedRectangle(float x, float y, float width, float height, TextureHandle texture) {
+        const TextureRegion* found = GetTextureRegion(texture);
+        if (!found) {
+            printf("Invalid texture handle: %u\n", texture.index);
+            return;
+        }
+        const TextureRegion& region = *found;
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+        if (!IsVisible(x, y, x + width, y + height)) {
+            return;
+        }
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+        // Image rows are stored top to bottom, so v0 is the top of the rectangle
+        BatchVertex vertices[4] = {
+            WorldVertex(x, y, region.u0, region.v1, WHITE, 1.0f),                  // Bottom-left
+            WorldVertex(x + width, y, region.u1, region.v1, WHITE, 1.0f),          // Bottom-right
+            WorldVertex(x + width, y + height, region.u1, region.v0, WHITE, 1.0f), // Top-right
+            WorldVertex(x, y + height, region.u0, region.v0, WHITE, 1.0f)          // Top-left
+        };
 
-        glUseProgram(shaderProgramShape);
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, transparency);
+        BatchQuad(GetDrawState().textureProgram, region.textureID, vertices);
+    }
 
-        glDrawArrays(GL_TRIANGLES, 0, 3);
 
-        glBindVertexArray(0);
+    void DrawTilemap(Tilemap& map) {
+        if (RejectWhileRecording("DrawTilemap")) {
+            return;
+        }
+        const DrawState& state = GetDrawState();
+        map.Draw(shaderProgramTexture, state.cullMinX, state.cullMinY, state.cullMaxX, state.cullMaxY);
     }
 
 
+    bool CreateRenderLayer(RenderLayer& layer, int width, int height) {
+        DestroyRenderLayer(layer);
 
-    // Texture System
-
-    void LoadTexture(const char* filepath, const std::string& name) {
-        glGenTextures(1, &textureID);
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glGenTextures(1, &layer.texture);
+        BindTexture(layer.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 
+        glGenFramebuffers(1, &layer.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, layer.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, layer.texture, 0);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, activeLayer ? activeLayer->framebuffer : (headless ? headlessFramebuffer : 0));
 
-        int width, height, nrChannels;
-        unsigned char* data = stbi_load(filepath, &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, nrChannels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-            textures[name] = textureID;  // Store the texture with the name in the map
-            std::cout << "Texture loaded: " << name << std::endl;
-        }
-        else {
-            std::cerr << "ERROR: Failed to load texture: " << filepath << std::endl;
+        if (!complete) {
+            std::cerr << "ERROR: Render layer framebuffer is incomplete (" << width << "x" << height << ")" << std::endl;
+            DestroyRenderLayer(layer);
+            return false;
         }
-        stbi_image_free(data);
-    }
 
+        layer.width = width;
+        layer.height = height;
+        layer.dirty = true;
+        return true;
+    }
 
-    void DrawTexturedRectangle(float x, float y, float width, float height, const std::string& name) {
-        // Retrieve window dimensions
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
-        float flippedY = windowHeight - y;
-
-        float vertices[] = {
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f, 0.0f, 0.0f, // Bottom-left
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f, 1.0f, 0.0f, // Bottom-right
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f, 1.0f, 1.0f, // Top-right
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f, 0.0f, 1.0f  // Top-left
-        };
+    void DestroyRenderLayer(RenderLayer& layer) {
+        if (!layer.framebuffer && !layer.texture) {
+            return;
+        }
 
+        FlushBatch(); // Queued quads may still sample the texture
+        glDeleteFramebuffers(1, &layer.framebuffer);
+        DeleteTexture(layer.texture);
+        layer = RenderLayer();
+    }
 
-        unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
+    void MarkRenderLayerDirty(RenderLayer& layer) {
+        layer.dirty = true;
+    }
 
-        if (textures.find(name) == textures.end()) {
-            printf("Texture not found: %s\n", name.c_str());
-            return;
+    bool BeginRenderLayer(RenderLayer& layer) {
+        if (RejectWhileRecording("BeginRenderLayer") || !layer.dirty || !layer.framebuffer) {
+            return false;
+        }
+        if (activeLayer) {
+            std::cerr << "ERROR: Render layers can't be nested, end the current one first" << std::endl;
+            return false;
         }
 
-        stbi_set_flip_vertically_on_load(true);
+        FlushBatch(); // What was drawn so far belongs to the screen
+        activeLayer = &layer;
 
-        
-        glUseProgram(shaderProgramText);  // Activate texture shader
+        glBindFramebuffer(GL_FRAMEBUFFER, layer.framebuffer);
+        glViewport(0, 0, layer.width, layer.height);
 
-        // ✅ Set full opacity for non-Pro textures
-        int alphaLocation = glGetUniformLocation(shaderProgramText, "alpha");
-        glUniform1f(alphaLocation, 1.0f);
+        // ClearBackground's color is for the next StartDrawing, keep it
+        GLfloat backgroundColor[4];
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, backgroundColor);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glClearColor(backgroundColor[0], backgroundColor[1], backgroundColor[2], backgroundColor[3]);
 
-        glBindTexture(GL_TEXTURE_2D, textures[name]);
+        SetRegistryViewProjection(glm::ortho(0.0f, (float)layer.width, 0.0f, (float)layer.height));
+        SetDrawState({ 0.0f, 0.0f, (float)layer.width, (float)layer.height, (float)layer.height, 1.0f, shaderProgramShape, shaderProgramTexture });
+        return true;
+    }
 
-        // Buffer and configure VAO, VBO, and EBO
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
+    void EndRenderLayer(RenderLayer& layer) {
+        if (RejectWhileRecording("EndRenderLayer")) {
+            return;
+        }
+        if (activeLayer != &layer) {
+            std::cerr << "ERROR: EndRenderLayer without a matching BeginRenderLayer" << std::endl;
+            return;
+        }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+        FlushBatch();
+        activeLayer = nullptr;
+        layer.dirty = false;
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+        BindScreenFramebuffer();
+        SetRegistryViewProjection(frameContext.viewProjection);
+        SetDrawState(screenDrawState);
+    }
 
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);  // Draw the rectangle
+    void DrawRenderLayer(const RenderLayer& layer, float x, float y, float alpha) {
+        if (!layer.texture || RejectWhileRecording("DrawRenderLayer")) {
+            return;
+        }
+
+        float width = (float)layer.width;
+        float height = (float)layer.height;
+        if (!IsVisible(x, y, x + width, y + height)) {
+            return;
+        }
+
+        // The texture is premultiplied, so alpha scales every channel and it is blended with GL_ONE
+        Color tint = { alpha, alpha, alpha, alpha };
+        BatchVertex vertices[4] = {
+            WorldVertex(x, y, 0.0f, 0.0f, tint, alpha),                  // Bottom-left, framebuffer rows start at the bottom
+            WorldVertex(x + width, y, 1.0f, 0.0f, tint, alpha),          // Bottom-right
+            WorldVertex(x + width, y + height, 1.0f, 1.0f, tint, alpha), // Top-right
+            WorldVertex(x, y + height, 0.0f, 1.0f, tint, alpha)          // Top-left
+        };
 
-        // Clean up
-        glBindVertexArray(0);
+        FlushBatch();
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        BatchQuad(shaderProgramTexture, layer.texture, vertices);
+        FlushBatch();
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
     }
 
 
     void DrawProTexturedRectangle(float x, float y, float width, float height, float rotation, float alpha, const std::string& name) {
-        if (textures.find(name) == textures.end()) {
+        TextureHandle texture = GetTextureHandle(name);
+        if (!texture.IsValid()) {
             printf("Texture not found: %s\n", name.c_str());
             return;
         }
+        DrawProTexturedRectangle(x, y, width, height, rotation, alpha, texture);
+    }
 
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    void DrawProTexturedRectangle(float x, float y, float width, float height, float rotation, float alpha, TextureHandle texture) {
+        const TextureRegion* found = GetTextureRegion(texture);
+        if (!found) {
+            printf("Invalid texture handle: %u\n", texture.index);
+            return;
+        }
+        const TextureRegion& region = *found;
 
         float halfWidth = width / 2.0f;
         float halfHeight = height / 2.0f;
 
+        float radius = std::sqrt(halfWidth * halfWidth + halfHeight * halfHeight);
+        float targetHeight = GetDrawState().height;
+        float centerY = targetHeight - y;
+        if (!IsVisible(x - radius, centerY - radius, x + radius, centerY + radius)) {
+            return;
+        }
+
         // Calculate rotated vertices
         float cosTheta = cos(rotation);
         float sinTheta = sin(rotation);
 
-        float vertices[] = {
-            -halfWidth * cosTheta - (-halfHeight) * sinTheta, -halfWidth * sinTheta + (-halfHeight) * cosTheta, 0.0f, 1.0f, // Top-left
-             halfWidth * cosTheta - (-halfHeight) * sinTheta,  halfWidth * sinTheta + (-halfHeight) * cosTheta, 1.0f, 1.0f, // Top-right
-             halfWidth * cosTheta - halfHeight * sinTheta,     halfWidth * sinTheta + halfHeight * cosTheta,    1.0f, 0.0f, // Bottom-right
-            -halfWidth * cosTheta - halfHeight * sinTheta,    -halfWidth * sinTheta + halfHeight * cosTheta,   0.0f, 0.0f  // Bottom-left
+        // x, y is the center of the rectangle and y grows downwards here
+        float corners[4][4] = {
+            { -halfWidth, -halfHeight, region.u0, region.v0 }, // Top-left
+            {  halfWidth, -halfHeight, region.u1, region.v0 }, // Top-right
+            {  halfWidth,  halfHeight, region.u1, region.v1 }, // Bottom-right
+            { -halfWidth,  halfHeight, region.u0, region.v1 }  // Bottom-left
         };
 
-        unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
-
-        // Move vertices to correct screen position
+        BatchVertex vertices[4];
         for (int i = 0; i < 4; i++) {
-            vertices[i * 4] = (vertices[i * 4] + x) / windowWidth * 2.0f - 1.0f;
-            vertices[i * 4 + 1] = 1.0f - ((vertices[i * 4 + 1] + y) / windowHeight * 2.0f);
+            float rx = corners[i][0] * cosTheta - corners[i][1] * sinTheta;
+            float ry = corners[i][0] * sinTheta + corners[i][1] * cosTheta;
+            vertices[i] = WorldVertex(x + rx, targetHeight - (y + ry), corners[i][2], corners[i][3], WHITE, alpha);
         }
 
-        glBindTexture(GL_TEXTURE_2D, textures[name]);
-
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
+        BatchQuad(GetDrawState().textureProgram, region.textureID, vertices);
+    }
 
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
 
-        glUseProgram(shaderProgramText);
+    void DrawRectangleInstanced(const QuadInstance* instances, size_t count) {
+        if (RejectWhileRecording("DrawRectangleInstanced")) {
+            return;
+        }
+        const float fullRegion[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+        DrawInstancedQuads(shaderProgramShape, 0, fullRegion, instances, count);
+    }
 
-        // Pass transparency to shader
-        int alphaLocation = glGetUniformLocation(shaderProgramText, "alpha");
-        glUniform1f(alphaLocation, alpha);
+    void DrawTexturedInstanced(const QuadInstance* instances, size_t count, const std::string& name) {
+        TextureHandle texture = GetTextureHandle(name);
+        if (!texture.IsValid()) {
+            printf("Texture not found: %s\n", name.c_str());
+            return;
+        }
+        DrawTexturedInstanced(instances, count, texture);
+    }
 
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    void DrawTexturedInstanced(const QuadInstance* instances, size_t count, TextureHandle texture) {
+        if (RejectWhileRecording("DrawTexturedInstanced")) {
+            return;
+        }
+        const TextureRegion* found = GetTextureRegion(texture);
+        if (!found) {
+            printf("Invalid texture handle: %u\n", texture.index);
+            return;
+        }
+        const TextureRegion& region = *found;
 
-        glBindVertexArray(0);
+        // Instance UVs are relative to the image, the shader maps them into its atlas rectangle
+        const float uvRegion[4] = { region.u0, region.v0, region.u1, region.v1 };
+        DrawInstancedQuads(shaderProgramTexture, region.textureID, uvRegion, instances, count);
     }
 
 
@@ -833,15 +1180,43 @@ void main()
     }
 
     float ech::GetDeltaTime() {
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<float> duration = std::chrono::duration_cast<std::chrono::duration<float>>(currentTime - lastTime);
-        lastTime = currentTime;
-        return duration.count();
+        return frameContext.deltaTime;
+    }
+
+    void SetFixedUpdate(FixedUpdateCallback update, float stepSeconds, int maxStepsPerFrame) {
+        if (stepSeconds <= 0.0f || maxStepsPerFrame < 1) {
+            std::cerr << "ERROR: Fixed update needs a positive step and at least one step per frame" << std::endl;
+            return;
+        }
+
+        fixedUpdate = std::move(update);
+        fixedStep = stepSeconds;
+        maxFixedSteps = maxStepsPerFrame;
+        fixedAccumulator = 0.0;
+        interpolationAlpha = 0.0f;
+    }
+
+    float GetInterpolationAlpha() {
+        return interpolationAlpha;
     }
 
 
+    static std::string fontCacheDirectory;
+
+    bool SetFontCacheDirectory(const std::string& directory) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "ERROR: Failed to create font cache directory: " << directory << " (" << error.message() << ")" << std::endl;
+            return false;
+        }
+
+        fontCacheDirectory = directory;
+        return true;
+    }
+
     // Function to load font with stb_truetype
-    bool LoadFont(const char* fontFile, int fontSize, Font& outFont) {
+    bool LoadFont(const char* fontFile, int fontSize, Font& outFont, FontType type) {
         // Open the font file
         FILE* fontFilePointer = fopen(fontFile, "rb");
         if (!fontFilePointer) {
@@ -849,69 +1224,42 @@ void main()
             return false;
         }
 
-        // Read the font file into a buffer
+        // Read the font file into a buffer, the glyph cache keeps it to rasterize glyphs later
         fseek(fontFilePointer, 0, SEEK_END);
         long length = ftell(fontFilePointer);
         fseek(fontFilePointer, 0, SEEK_SET);
-        unsigned char* ttfBuffer = (unsigned char*)malloc(length);
-        fread(ttfBuffer, 1, length, fontFilePointer);
+        std::vector<unsigned char> ttfBuffer(length > 0 ? length : 0);
+        size_t read = fread(ttfBuffer.data(), 1, ttfBuffer.size(), fontFilePointer);
         fclose(fontFilePointer);
+        ttfBuffer.resize(read);
 
-        // Initialize font using stb_truetype
-        stbtt_fontinfo fontInfo;
-        if (!stbtt_InitFont(&fontInfo, ttfBuffer, stbtt_GetFontOffsetForIndex(ttfBuffer, 0))) {
-            std::cerr << "Failed to initialize font!" << std::endl;
-            free(ttfBuffer);
-            return false;
-        }
-
-        // Generate OpenGL texture
-        glGenTextures(1, &outFont.textureID);
-        glBindTexture(GL_TEXTURE_2D, outFont.textureID);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-        unsigned char* bitmap = new unsigned char[FONT_BITMAP_WIDTH * FONT_BITMAP_HEIGHT](); // Initialize bitmap
-
-        // Bake the font into the bitmap (character range 32 to 96)
-        int numCharsBaked = stbtt_BakeFontBitmap(ttfBuffer, 0, fontSize, bitmap,
-            FONT_BITMAP_WIDTH, FONT_BITMAP_HEIGHT,
-            32, 96, outFont.characterData);
+        uint64_t fontHash = HashBytes(ttfBuffer.data(), ttfBuffer.size());
 
-        if (numCharsBaked != 256) {
-            std::cerr << "Error: Not all characters were baked successfully! Only " << numCharsBaked << " characters baked." << std::endl;
-            delete[] bitmap;
-            free(ttfBuffer);
+        // Nothing is rasterized yet, the atlas starts small and only holds glyphs that were drawn
+        std::shared_ptr<GlyphCache> glyphs = std::make_shared<GlyphCache>();
+        if (!glyphs->Init(std::move(ttfBuffer), (float)fontSize, type == FontType::SDF)) {
+            std::cerr << "Failed to initialize font!" << std::endl;
             return false;
         }
 
-        // Upload bitmap to OpenGL texture
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, FONT_BITMAP_WIDTH, FONT_BITMAP_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, bitmap);
-
-        outFont.textureWidth = FONT_BITMAP_WIDTH;
-        outFont.textureHeight = FONT_BITMAP_HEIGHT;
-
-        delete[] bitmap;
-        free(ttfBuffer);
-
-        // Validate baked character data
-        bool invalidCharFound = false;
-        for (int i = 0; i < 256; ++i) {
-            const stbtt_bakedchar& c = outFont.characterData[i];
-            if (c.x0 == c.x1 || c.y0 == c.y1) {
-                std::cerr << "Skipping invalid character at index " << i << ": "
-                    << "x0=" << c.x0 << ", x1=" << c.x1 << ", "
-                    << "y0=" << c.y0 << ", y1=" << c.y1 << std::endl;
-                invalidCharFound = true;
+        if (!fontCacheDirectory.empty()) {
+            char cacheName[64];
+            snprintf(cacheName, sizeof(cacheName), "%016llx_%d%s.echfont", (unsigned long long)fontHash, fontSize, type == FontType::SDF ? "_sdf" : "");
+            std::string cachePath = (std::filesystem::path(fontCacheDirectory) / cacheName).string();
+
+            if (!glyphs->LoadCache(cachePath.c_str(), fontHash)) {
+                // First run with this font and size, bake what almost every string needs and keep it for next time
+                char printable[96] = {};
+                for (int i = 0; i < 95; i++) {
+                    printable[i] = (char)(32 + i);
+                }
+                glyphs->Prepare(printable);
+                glyphs->SaveCache(cachePath.c_str(), fontHash);
             }
         }
 
-        if (invalidCharFound) {
-            std::cerr << "Warning: Some characters were invalid during baking!" << std::endl;
-        }
-
+        outFont.glyphs = glyphs;
+        outFont.size = fontSize;
         return true;
     }
 
@@ -926,8 +1274,8 @@ void main()
             return;
         }
 
-        if (font.textureID == 0) {
-            std::cerr << "Error: Font texture not loaded!" << std::endl;
+        if (!font.glyphs) {
+            std::cerr << "Error: Font not loaded!" << std::endl;
             return;
         }
 
@@ -936,77 +1284,67 @@ void main()
             return;
         }
 
-        glUseProgram(shaderProgramText);
-
-        GLint textColorLocation = glGetUniformLocation(shaderProgramText, "textColor");
-        glUniform4f(textColorLocation, color.r, color.g, color.b, color.a);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, font.textureID);
-
-        static GLuint VAO = 0, VBO = 0;
-        if (VAO == 0) {
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
+        if (RejectWhileRecording("DrawText")) {
+            return;
         }
 
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+        // The width isn't known before the glyphs are looked up, but a line above, below or right of the view
+        // can be skipped before anything gets rasterized. Half a line of margin covers SDF padding and overhangs.
+        float scale = GetTextScale(font, fontSize);
+        float margin = font.glyphs->GetLineHeight() * scale * 0.5f;
+        float top = y + font.glyphs->GetAscent() * scale + margin;
+        float bottom = y + font.glyphs->GetDescent() * scale - margin;
+        if (!IsVisible(x - margin, bottom, FLT_MAX, top)) {
+            return;
+        }
 
-        float xPos = x, yPos = y;
+        // Glyphs go into the batch like sprites, a screen full of text in one font is a single draw call
+        // Rasterize missing glyphs first, that may grow the atlas and change the UVs of the others
+        font.glyphs->Prepare(text);
 
-        // Loop through each character in the text string
-        for (const char* p = text; *p; ++p) {
-            if (*p == 32) { // Skip space manually (ASCII 32)
-                xPos += fontSize; // Add spacing for the space character
-                continue;
-            }
+        static std::vector<BatchVertex> textVertices;
+        textVertices.clear();
+        BuildTextVertices(font, text, x, y, scale, color, textVertices);
 
-            if (*p < 32 || *p >= 127) continue;  // Skip characters outside the baked range (32-126)
+        GLuint program = font.glyphs->IsSdf() ? shaderProgramTextSdf : shaderProgramText;
+        GLuint texture = font.glyphs->GetTexture();
+        for (size_t i = 0; i + 4 <= textVertices.size(); i += 4) {
+            BatchQuad(program, texture, &textVertices[i]);
+        }
+    }
 
-            stbtt_bakedchar& c = font.characterData[*p - 32]; // Access the baked character
+    void DrawTextLayout(Font& font, const TextLayout& layout, float x, float y, Color color) {
+        if (RejectWhileRecording("DrawTextLayout")) {
+            return;
+        }
 
-            // If character data is invalid (zero width or height), skip it
-            if (c.x0 == c.x1 || c.y0 == c.y1) {
-                std::cerr << "Skipping invalid character: " << *p << std::endl;
-                continue;
-            }
+        if (!font.glyphs || layout.shapedWith != font.glyphs.get()) {
+            std::cerr << "Error: Text layout was shaped with a different font!" << std::endl;
+            return;
+        }
 
-            // Calculate the position and size for the character quad
-            float x2 = xPos + c.xoff;
-            float y2 = yPos - c.yoff;
-            float w = c.x1 - c.x0;
-            float h = c.y1 - c.y0;
-
-            // Create the vertices for the quad
-            float vertices[6][4] = {
-                { x2,     y2 + h,   c.x0 / font.textureWidth, c.y1 / font.textureHeight },
-                { x2,     y2,       c.x0 / font.textureWidth, c.y0 / font.textureHeight },
-                { x2 + w, y2,       c.x1 / font.textureWidth, c.y0 / font.textureHeight },
-                { x2,     y2 + h,   c.x0 / font.textureWidth, c.y1 / font.textureHeight },
-                { x2 + w, y2,       c.x1 / font.textureWidth, c.y0 / font.textureHeight },
-                { x2 + w, y2 + h,   c.x1 / font.textureWidth, c.y1 / font.textureHeight }
-            };
+        // The bounds are glyph boxes already, only SDF padding sticks out a little
+        float margin = font.glyphs->GetLineHeight() * layout.scale * 0.5f;
+        if (!IsVisible(x + layout.minX - margin, y + layout.minY - margin, x + layout.maxX + margin, y + layout.maxY + margin)) {
+            return;
+        }
 
-            // Update the vertex buffer with the new data
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        // Glyphs may have been evicted since the layout was shaped, bring them back before building quads
+        for (const TextLayoutGlyph& glyph : layout.glyphs) {
+            font.glyphs->Prepare(glyph.codepoint);
+        }
 
-            // Draw the character as a quad
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        static std::vector<BatchVertex> textVertices;
+        textVertices.clear();
+        BuildTextLayoutVertices(font, layout, x, y, color, textVertices);
 
-            // Advance to the next character's position
-            xPos += c.xadvance;
+        GLuint program = font.glyphs->IsSdf() ? shaderProgramTextSdf : shaderProgramText;
+        GLuint texture = font.glyphs->GetTexture();
+        for (size_t i = 0; i + 4 <= textVertices.size(); i += 4) {
+            BatchQuad(program, texture, &textVertices[i]);
         }
 
 
-        glBindVertexArray(0);
     }
 
 
@@ -1027,37 +1365,7 @@ void main()
     }
 
     void DrawRectangleCollisionShape(float x, float y, float width, float height, const Color& color) {
-        glUseProgram(shaderProgramShape);  // Use shape shader
-
-        int windowWidth, windowHeight;
-        glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
-
-        float flippedY = windowHeight - y;
-
-        float vertices[] = {
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - (flippedY / windowHeight) * 2.0f,
-            ((x + width) / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f,
-            (x / windowWidth) * 2.0f - 1.0f, 1.0f - ((flippedY - height) / windowHeight) * 2.0f
-        };
-
-        unsigned int indices[] = { 0, 1, 2, 2, 3, 0 };
-
-        glUniform4f(glGetUniformLocation(shaderProgramShape, "uColor"), color.r, color.g, color.b, color.a);
-
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_DYNAMIC_DRAW);
-
-        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        glBindVertexArray(0);
+        DrawRectangle(x, y, width, height, color);
     }
 
 
@@ -0,0 +1,128 @@
+#include "framePacer.h"
+#include "echlib.h"
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <time.h>
+#endif
+
+
+namespace ech {
+
+    using PacerClock = std::chrono::steady_clock;
+
+    // Sleeps wake up late by up to a scheduler tick, so the last part of the wait is spun instead.
+    // clock_nanosleep is usually within ~100us, the generic sleep can be off by whole milliseconds.
+#ifdef __linux__
+    static constexpr auto spinMargin = std::chrono::microseconds(500);
+#else
+    static constexpr auto spinMargin = std::chrono::microseconds(2000);
+#endif
+
+    static constexpr int frameSampleCount = 120; // Frames the stats are computed over
+
+    static int targetFps = 0;
+    static PacerClock::time_point nextDeadline;
+    static PacerClock::time_point lastFrameEnd;
+
+    static float frameSamples[frameSampleCount];
+    static int frameSampleCursor = 0;
+    static int frameSamplesFilled = 0;
+    static FrameTimeStats frameTimeStats = {};
+
+
+    static void SleepUntil(PacerClock::time_point deadline) {
+#ifdef __linux__
+        // steady_clock is CLOCK_MONOTONIC here, an absolute deadline doesn't drift when the sleep is interrupted
+        auto sinceEpoch = deadline.time_since_epoch();
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+        timespec wakeUp;
+        wakeUp.tv_sec = (time_t)seconds.count();
+        wakeUp.tv_nsec = (long)std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch - seconds).count();
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeUp, nullptr) == EINTR) {
+        }
+#else
+        std::this_thread::sleep_until(deadline);
+#endif
+    }
+
+    static void WaitUntil(PacerClock::time_point deadline) {
+        if (deadline - PacerClock::now() > spinMargin) {
+            SleepUntil(deadline - spinMargin);
+        }
+
+        while (PacerClock::now() < deadline) {
+        }
+    }
+
+    static void RecordFrameTime(float frameMs) {
+        frameSamples[frameSampleCursor] = frameMs;
+        frameSampleCursor = (frameSampleCursor + 1) % frameSampleCount;
+        if (frameSamplesFilled < frameSampleCount) {
+            frameSamplesFilled++;
+        }
+
+        float sum = 0.0f;
+        float minMs = frameSamples[0];
+        float maxMs = frameSamples[0];
+        for (int i = 0; i < frameSamplesFilled; i++) {
+            sum += frameSamples[i];
+            minMs = std::fmin(minMs, frameSamples[i]);
+            maxMs = std::fmax(maxMs, frameSamples[i]);
+        }
+        float average = sum / frameSamplesFilled;
+
+        float variance = 0.0f;
+        for (int i = 0; i < frameSamplesFilled; i++) {
+            float difference = frameSamples[i] - average;
+            variance += difference * difference;
+        }
+
+        frameTimeStats.frameMs = frameMs;
+        frameTimeStats.averageMs = average;
+        frameTimeStats.minMs = minMs;
+        frameTimeStats.maxMs = maxMs;
+        frameTimeStats.jitterMs = std::sqrt(variance / frameSamplesFilled);
+    }
+
+    void PaceFrame(bool limit) {
+        if (limit && targetFps > 0) {
+            auto period = std::chrono::duration_cast<PacerClock::duration>(std::chrono::duration<double>(1.0 / targetFps));
+            auto now = PacerClock::now();
+
+            // Deadlines advance by exactly one period so small hitches are absorbed by the next frame.
+            // More than a frame behind (first frame, breakpoint, loading) starts over instead of rushing to catch up.
+            if (nextDeadline == PacerClock::time_point() || now > nextDeadline + period) {
+                nextDeadline = now;
+            }
+            else {
+                WaitUntil(nextDeadline);
+            }
+            nextDeadline += period;
+            frameTimeStats.targetMs = 1000.0f / targetFps;
+        }
+        else {
+            nextDeadline = PacerClock::time_point();
+            frameTimeStats.targetMs = 0.0f;
+        }
+
+        auto frameEnd = PacerClock::now();
+        if (lastFrameEnd != PacerClock::time_point()) {
+            RecordFrameTime(std::chrono::duration<float, std::milli>(frameEnd - lastFrameEnd).count());
+        }
+        lastFrameEnd = frameEnd;
+    }
+
+    void SetTargetFps(int target) {
+        targetFps = target;
+        nextDeadline = PacerClock::time_point();
+    }
+
+    const FrameTimeStats& GetFrameTimeStats() {
+        return frameTimeStats;
+    }
+
+}
@@ -0,0 +1,113 @@
+#include "glState.h"
+#include "batchRenderer.h"
+#include "echlib.h"
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <string>
+#include <string_view>
+
+
+namespace ech {
+
+    // 0 is a valid object to bind, so "unknown" needs its own value
+    static const GLuint UNKNOWN_BINDING = 0xFFFFFFFF;
+
+    static GLuint currentProgram = UNKNOWN_BINDING;
+    static GLuint currentVertexArray = UNKNOWN_BINDING;
+    static GLuint currentTexture = UNKNOWN_BINDING;
+
+    // std::less<> makes find(const char*) compare in place, a lookup never builds a std::string.
+    // Programs have a handful of uniforms, so the ordered map is as quick as hashing the name would be.
+    using UniformMap = std::map<std::string, GLint, std::less<>>;
+    static std::unordered_map<GLuint, UniformMap> uniformLocations;
+
+
+    void UseProgram(GLuint program) {
+        if (program == currentProgram) {
+            GetFrameStats().glCallsElided++;
+            return;
+        }
+        glUseProgram(program);
+        currentProgram = program;
+    }
+
+    void BindVertexArray(GLuint vao) {
+        if (vao == currentVertexArray) {
+            GetFrameStats().glCallsElided++;
+            return;
+        }
+        glBindVertexArray(vao);
+        currentVertexArray = vao;
+    }
+
+    void BindTexture(GLuint texture) {
+        if (texture == currentTexture) {
+            GetFrameStats().glCallsElided++;
+            return;
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        currentTexture = texture;
+    }
+
+    void DeleteTexture(GLuint texture) {
+        glDeleteTextures(1, &texture);
+        if (currentTexture == texture) {
+            currentTexture = UNKNOWN_BINDING;
+        }
+    }
+
+    void CacheProgramUniforms(GLuint program) {
+        auto& locations = uniformLocations[program];
+        locations.clear();
+
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+
+        char name[256];
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, sizeof(name), &length, &size, &type, name);
+
+            // Arrays are reported as "name[0]", store them under both names
+            std::string uniformName(name, length);
+            GLint location = glGetUniformLocation(program, uniformName.c_str());
+            locations[uniformName] = location;
+
+            size_t bracket = uniformName.find('[');
+            if (bracket != std::string::npos) {
+                locations[uniformName.substr(0, bracket)] = location;
+            }
+        }
+    }
+
+    void ForgetProgramUniforms(GLuint program) {
+        uniformLocations.erase(program);
+        if (currentProgram == program) {
+            currentProgram = UNKNOWN_BINDING;
+        }
+    }
+
+    GLint GetUniformLocation(GLuint program, const char* name) {
+        auto programUniforms = uniformLocations.find(program);
+        if (programUniforms == uniformLocations.end()) {
+            return -1;
+        }
+
+        auto location = programUniforms->second.find(std::string_view(name));
+        if (location == programUniforms->second.end()) {
+            return -1;
+        }
+        return location->second;
+    }
+
+    void ResetGlStateCache() {
+        currentProgram = UNKNOWN_BINDING;
+        currentVertexArray = UNKNOWN_BINDING;
+        currentTexture = UNKNOWN_BINDING;
+    }
+
+}
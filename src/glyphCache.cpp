@@ -0,0 +1,444 @@
+#include "glyphCache.h"
+#include "batchRenderer.h"
+#include "textRenderer.h"
+#include "glState.h"
+#include "mappedFile.h"
+#include "echlib.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+namespace ech {
+
+    static const int INITIAL_ATLAS_SIZE = 256;
+    static const int MAX_ATLAS_SIZE = 2048;
+
+    // Empty pixels right of and below every glyph, so linear filtering never picks up a neighbour
+    static const int GLYPH_PADDING = 1;
+
+    // SDF glyphs get this many pixels of distance field around them, the edge is stored as 128
+    static const int SDF_PADDING = 6;
+    static const unsigned char SDF_ON_EDGE = 128;
+    static const float SDF_DISTANCE_SCALE = (float)SDF_ON_EDGE / SDF_PADDING;
+
+    static const char CACHE_MAGIC[8] = { 'E', 'C', 'H', 'F', 'O', 'N', 'T', 0 };
+    static const uint32_t CACHE_VERSION = 1;
+
+
+    bool GlyphCache::Init(std::vector<unsigned char> data, float height, bool signedDistance) {
+        fontData = std::move(data);
+        if (fontData.empty() || !stbtt_InitFont(&fontInfo, fontData.data(), stbtt_GetFontOffsetForIndex(fontData.data(), 0))) {
+            return false;
+        }
+
+        pixelHeight = height;
+        sdf = signedDistance;
+        scale = stbtt_ScaleForPixelHeight(&fontInfo, pixelHeight);
+
+        int fontAscent, fontDescent, fontLineGap;
+        stbtt_GetFontVMetrics(&fontInfo, &fontAscent, &fontDescent, &fontLineGap);
+        ascent = fontAscent * scale;
+        descent = fontDescent * scale;
+        lineGap = fontLineGap * scale;
+
+        // The atlas itself is only created by the first glyph, or comes from LoadCache
+        glGenTextures(1, &texture);
+        BindTexture(texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return true;
+    }
+
+    void GlyphCache::CreateAtlas() {
+        atlasWidth = INITIAL_ATLAS_SIZE;
+        atlasHeight = INITIAL_ATLAS_SIZE;
+        pixels.assign((size_t)atlasWidth * atlasHeight, 0);
+
+        BindTexture(texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Layout: magic, version, font hash, pixel height, sdf, atlas width and height, shelf count, glyph count,
+    // then every shelf (y, height, used width), every glyph (codepoint, x, y, width, height, xoff, yoff, advance, shelf)
+    // and last the atlas pixels
+    bool GlyphCache::SaveCache(const char* filepath, uint64_t fontHash) const {
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for saving: " << filepath << std::endl;
+            return false;
+        }
+
+        auto write = [&file](const auto& value) {
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            };
+
+        file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        write(CACHE_VERSION);
+        write(fontHash);
+        write(pixelHeight);
+        write((uint32_t)sdf);
+        write((uint32_t)atlasWidth);
+        write((uint32_t)atlasHeight);
+        write((uint32_t)shelves.size());
+        write((uint32_t)glyphs.size());
+
+        for (const Shelf& shelf : shelves) {
+            write((int32_t)shelf.y);
+            write((int32_t)shelf.height);
+            write((int32_t)shelf.usedWidth);
+        }
+
+        for (const auto& entry : glyphs) {
+            const Glyph& glyph = entry.second;
+            write(entry.first);
+            write((int32_t)glyph.x);
+            write((int32_t)glyph.y);
+            write((int32_t)glyph.width);
+            write((int32_t)glyph.height);
+            write(glyph.xoff);
+            write(glyph.yoff);
+            write(glyph.advance);
+            write((int32_t)glyph.shelf);
+        }
+
+        file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+        return file.good();
+    }
+
+    bool GlyphCache::LoadCache(const char* filepath, uint64_t fontHash) {
+        MappedFile file;
+        if (!file.Open(filepath)) {
+            return false;
+        }
+
+        const unsigned char* cursor = file.GetData();
+        const unsigned char* end = cursor + file.GetSize();
+        bool truncated = false;
+
+        auto read = [&](auto& value) {
+            if ((size_t)(end - cursor) < sizeof(value)) {
+                truncated = true;
+                return;
+            }
+            memcpy(&value, cursor, sizeof(value));
+            cursor += sizeof(value);
+            };
+
+        char magic[sizeof(CACHE_MAGIC)] = {};
+        uint32_t version = 0, cachedSdf = 0, width = 0, height = 0, shelfCount = 0, glyphCount = 0;
+        uint64_t cachedHash = 0;
+        float cachedPixelHeight = 0.0f;
+
+        read(magic);
+        read(version);
+        read(cachedHash);
+        read(cachedPixelHeight);
+        read(cachedSdf);
+        read(width);
+        read(height);
+        read(shelfCount);
+        read(glyphCount);
+
+        // A different font file, size, type or format version just means the cache gets rebuilt
+        if (truncated || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version != CACHE_VERSION || cachedHash != fontHash ||
+            cachedPixelHeight != pixelHeight || (cachedSdf != 0) != sdf || width == 0 || height == 0 ||
+            width > (uint32_t)MAX_ATLAS_SIZE || height > (uint32_t)MAX_ATLAS_SIZE) {
+            return false;
+        }
+
+        // Each shelf is 3 int32 in the file, a count the file can't hold is rejected before allocating for it
+        if (shelfCount > (size_t)(end - cursor) / (3 * sizeof(int32_t))) {
+            return false;
+        }
+
+        std::vector<Shelf> loadedShelves(shelfCount);
+        for (Shelf& shelf : loadedShelves) {
+            int32_t y = 0, shelfHeight = 0, usedWidth = 0;
+            read(y);
+            read(shelfHeight);
+            read(usedWidth);
+            if (y < 0 || shelfHeight <= 0 || shelfHeight > (int32_t)height - y || usedWidth < 0 || usedWidth > (int32_t)width) {
+                return false;
+            }
+            shelf = { y, shelfHeight, usedWidth, 0, {} };
+        }
+
+        std::unordered_map<uint32_t, Glyph> loadedGlyphs;
+        for (uint32_t i = 0; i < glyphCount && !truncated; i++) {
+            uint32_t codepoint = 0;
+            int32_t x = 0, y = 0, glyphWidth = 0, glyphHeight = 0, shelf = -1;
+            Glyph glyph = {};
+            read(codepoint);
+            read(x);
+            read(y);
+            read(glyphWidth);
+            read(glyphHeight);
+            read(glyph.xoff);
+            read(glyph.yoff);
+            read(glyph.advance);
+            read(shelf);
+
+            // Subtracted instead of added so huge values can't overflow past the checks
+            if (shelf < -1 || shelf >= (int32_t)shelfCount || x < 0 || y < 0 || glyphWidth < 0 || glyphHeight < 0 ||
+                glyphWidth > (int32_t)width - x || glyphHeight > (int32_t)height - y) {
+                return false;
+            }
+            glyph.x = x;
+            glyph.y = y;
+            glyph.width = glyphWidth;
+            glyph.height = glyphHeight;
+            glyph.shelf = shelf;
+
+            loadedGlyphs[codepoint] = glyph;
+            if (shelf >= 0) {
+                loadedShelves[shelf].glyphs.push_back(codepoint);
+            }
+        }
+
+        size_t pixelCount = (size_t)width * height;
+        if (truncated || (size_t)(end - cursor) < pixelCount) {
+            std::cerr << "ERROR: Font cache file is truncated: " << filepath << std::endl;
+            return false;
+        }
+
+        // The one upload of the whole font, straight from the mapped file
+        BindTexture(texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, (GLsizei)width, (GLsizei)height, 0, GL_RED, GL_UNSIGNED_BYTE, cursor);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        // New glyphs are still rasterized into the CPU copy
+        pixels.assign(cursor, cursor + pixelCount);
+        atlasWidth = (int)width;
+        atlasHeight = (int)height;
+        shelves = std::move(loadedShelves);
+        glyphs = std::move(loadedGlyphs);
+        return true;
+    }
+
+    void GlyphCache::Prepare(const char* text) {
+        for (const char* p = text; *p; ) {
+            Prepare(NextCodepoint(p));
+        }
+    }
+
+    void GlyphCache::Prepare(uint32_t codepoint) {
+        if (codepoint < 32) {
+            return;
+        }
+
+        uint64_t frame = GetFrameContext().frameIndex;
+        auto glyph = glyphs.find(codepoint);
+        if (glyph == glyphs.end()) {
+            Rasterize(codepoint, frame);
+        }
+        else if (glyph->second.shelf >= 0) {
+            shelves[glyph->second.shelf].lastUsed = frame;
+        }
+    }
+
+    const GlyphCache::Glyph* GlyphCache::FindGlyph(uint32_t codepoint) const {
+        auto glyph = glyphs.find(codepoint);
+        if (glyph == glyphs.end()) {
+            return nullptr;
+        }
+        return &glyph->second;
+    }
+
+    float GlyphCache::GetKerning(uint32_t left, uint32_t right) const {
+        return stbtt_GetCodepointKernAdvance(&fontInfo, (int)left, (int)right) * scale;
+    }
+
+    bool GlyphCache::Rasterize(uint32_t codepoint, uint64_t frame) {
+        if (atlasWidth == 0) {
+            CreateAtlas();
+        }
+
+        int advance, leftSideBearing;
+        stbtt_GetCodepointHMetrics(&fontInfo, (int)codepoint, &advance, &leftSideBearing);
+
+        Glyph glyph = { 0, 0, 0, 0, 0.0f, 0.0f, advance * scale, -1 };
+
+        // stb_truetype builds the distance field in its own buffer, plain bitmaps are rendered straight into the atlas
+        unsigned char* distanceField = nullptr;
+        if (sdf) {
+            int xoff = 0, yoff = 0;
+            distanceField = stbtt_GetCodepointSDF(&fontInfo, scale, (int)codepoint, SDF_PADDING, SDF_ON_EDGE, SDF_DISTANCE_SCALE,
+                &glyph.width, &glyph.height, &xoff, &yoff);
+            glyph.xoff = (float)xoff;
+            glyph.yoff = (float)yoff;
+        }
+        else {
+            int x0, y0, x1, y1;
+            stbtt_GetCodepointBitmapBox(&fontInfo, (int)codepoint, scale, scale, &x0, &y0, &x1, &y1);
+            glyph.width = x1 - x0;
+            glyph.height = y1 - y0;
+            glyph.xoff = (float)x0;
+            glyph.yoff = (float)y0;
+        }
+
+        if (!distanceField && sdf) {
+            glyph.width = 0; // Nothing to draw, like a space
+        }
+
+        if (glyph.width <= 0 || glyph.height <= 0) {
+            glyph.width = 0;
+            glyph.height = 0;
+            glyphs[codepoint] = glyph;
+            return true;
+        }
+
+        int shelfIndex = FindShelf(glyph.width + GLYPH_PADDING, glyph.height + GLYPH_PADDING, frame);
+        if (shelfIndex < 0) {
+            std::cerr << "Warning: Glyph atlas is full, codepoint " << codepoint << " is skipped this frame" << std::endl;
+            stbtt_FreeSDF(distanceField, fontInfo.userdata);
+            return false;
+        }
+
+        Shelf& shelf = shelves[shelfIndex];
+        glyph.x = shelf.usedWidth;
+        glyph.y = shelf.y;
+        glyph.shelf = shelfIndex;
+
+        shelf.usedWidth += glyph.width + GLYPH_PADDING;
+        shelf.lastUsed = frame;
+        shelf.glyphs.push_back(codepoint);
+
+        unsigned char* destination = &pixels[(size_t)glyph.y * atlasWidth + glyph.x];
+        if (distanceField) {
+            for (int row = 0; row < glyph.height; row++) {
+                memcpy(destination + (size_t)row * atlasWidth, distanceField + (size_t)row * glyph.width, glyph.width);
+            }
+            stbtt_FreeSDF(distanceField, fontInfo.userdata);
+        }
+        else {
+            stbtt_MakeCodepointBitmap(&fontInfo, destination, glyph.width, glyph.height, atlasWidth, scale, scale, (int)codepoint);
+        }
+        UploadRegion(glyph.x, glyph.y, glyph.width, glyph.height);
+
+        glyphs[codepoint] = glyph;
+        return true;
+    }
+
+    int GlyphCache::FindShelf(int width, int height, uint64_t frame) {
+        // Lowest shelf the glyph fits in, but not one so tall that most of it would be wasted
+        auto findOpenShelf = [&]() {
+            int best = -1;
+            for (size_t i = 0; i < shelves.size(); i++) {
+                const Shelf& shelf = shelves[i];
+                if (shelf.height < height || shelf.height > height + height / 2 || atlasWidth - shelf.usedWidth < width) {
+                    continue;
+                }
+                if (best < 0 || shelf.height < shelves[best].height) {
+                    best = (int)i;
+                }
+            }
+            return best;
+            };
+
+        int shelf = findOpenShelf();
+        if (shelf >= 0) {
+            return shelf;
+        }
+
+        // Open a new shelf below the last one, growing the atlas until there is room for it
+        while (width <= atlasWidth) {
+            int top = shelves.empty() ? 0 : shelves.back().y + shelves.back().height;
+            if (top + height <= atlasHeight) {
+                shelves.push_back({ top, height, 0, frame, {} });
+                return (int)shelves.size() - 1;
+            }
+
+            if (!Grow()) {
+                break;
+            }
+
+            // A wider atlas gives every existing shelf more room
+            shelf = findOpenShelf();
+            if (shelf >= 0) {
+                return shelf;
+            }
+        }
+
+        if (width > atlasWidth) {
+            return -1;
+        }
+
+        // Full for good: reuse the least recently used shelf that is tall enough.
+        // Shelves drawn from this frame are kept, their quads may still be waiting in the batch.
+        int oldest = -1;
+        for (size_t i = 0; i < shelves.size(); i++) {
+            const Shelf& candidate = shelves[i];
+            if (candidate.height < height || candidate.lastUsed == frame) {
+                continue;
+            }
+            if (oldest < 0 || candidate.lastUsed < shelves[oldest].lastUsed) {
+                oldest = (int)i;
+            }
+        }
+
+        if (oldest < 0) {
+            return -1;
+        }
+
+        Shelf& evicted = shelves[oldest];
+        for (uint32_t codepoint : evicted.glyphs) {
+            glyphs.erase(codepoint);
+        }
+        evicted.glyphs.clear();
+        evicted.usedWidth = 0;
+
+        memset(&pixels[(size_t)evicted.y * atlasWidth], 0, (size_t)evicted.height * atlasWidth);
+        UploadRegion(0, evicted.y, atlasWidth, evicted.height);
+        return oldest;
+    }
+
+    bool GlyphCache::Grow() {
+        if (atlasWidth >= MAX_ATLAS_SIZE && atlasHeight >= MAX_ATLAS_SIZE) {
+            return false;
+        }
+
+        // Height first, a taller atlas fits more shelves
+        int newWidth = atlasWidth;
+        int newHeight = atlasHeight;
+        if (atlasHeight <= atlasWidth && atlasHeight < MAX_ATLAS_SIZE) {
+            newHeight *= 2;
+        }
+        else {
+            newWidth *= 2;
+        }
+
+        std::vector<unsigned char> grown((size_t)newWidth * newHeight, 0);
+        for (int row = 0; row < atlasHeight; row++) {
+            memcpy(&grown[(size_t)row * newWidth], &pixels[(size_t)row * atlasWidth], atlasWidth);
+        }
+
+        pixels.swap(grown);
+        atlasWidth = newWidth;
+        atlasHeight = newHeight;
+
+        // Batched glyph quads have UVs for the old size, they have to be drawn before it changes
+        FlushBatch();
+
+        BindTexture(texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return true;
+    }
+
+    void GlyphCache::UploadRegion(int x, int y, int width, int height) {
+        BindTexture(texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, atlasWidth);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED, GL_UNSIGNED_BYTE, &pixels[(size_t)y * atlasWidth + x]);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+}
@@ -0,0 +1,107 @@
+#include "mappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace ech {
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+#ifdef _WIN32
+
+    bool MappedFile::Open(const char* filepath) {
+        Close();
+
+        HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        fileHandle = file;
+        mappingHandle = mapping;
+        data = (const unsigned char*)view;
+        size = (size_t)fileSize.QuadPart;
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data) {
+            UnmapViewOfFile(data);
+            CloseHandle((HANDLE)mappingHandle);
+            CloseHandle((HANDLE)fileHandle);
+        }
+        data = nullptr;
+        size = 0;
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+    }
+
+#else
+
+    bool MappedFile::Open(const char* filepath) {
+        Close();
+
+        int file = open(filepath, O_RDONLY);
+        if (file < 0) {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(file, &info) != 0 || info.st_size == 0) {
+            close(file);
+            return false;
+        }
+
+        // The mapping stays valid after the descriptor is closed
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        data = (const unsigned char*)view;
+        size = (size_t)info.st_size;
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data) {
+            munmap((void*)data, size);
+        }
+        data = nullptr;
+        size = 0;
+    }
+
+#endif
+
+}
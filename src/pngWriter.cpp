@@ -0,0 +1,110 @@
+#include "pngWriter.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+
+namespace ech {
+
+    static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+        static uint32_t table[256];
+        static bool tableReady = false;
+        if (!tableReady) {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                }
+                table[i] = value;
+            }
+            tableReady = true;
+        }
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static void PutBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    // Length, type, data, then the CRC of type and data
+    static void WriteChunk(std::ofstream& file, const char type[4], const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> chunk;
+        PutBigEndian(chunk, (uint32_t)data.size());
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        PutBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+
+    bool WritePng(const char* filepath, const unsigned char* pixels, int width, int height) {
+        if (!pixels || width <= 0 || height <= 0) {
+            return false;
+        }
+
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for saving: " << filepath << std::endl;
+            return false;
+        }
+
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        std::vector<unsigned char> header;
+        PutBigEndian(header, (uint32_t)width);
+        PutBigEndian(header, (uint32_t)height);
+        header.push_back(8); // Bits per channel
+        header.push_back(6); // RGBA
+        header.push_back(0); // Deflate
+        header.push_back(0); // Adaptive filtering
+        header.push_back(0); // Not interlaced
+        WriteChunk(file, "IHDR", header);
+
+        // Every row starts with its filter type, 0 leaves the bytes as they are
+        size_t rowSize = (size_t)width * 4;
+        std::vector<unsigned char> rows;
+        rows.reserve((rowSize + 1) * height);
+        for (int y = 0; y < height; y++) {
+            rows.push_back(0);
+            rows.insert(rows.end(), pixels + y * rowSize, pixels + (y + 1) * rowSize);
+        }
+
+        // A zlib stream made of stored deflate blocks (at most 65535 bytes each) and the Adler-32 of the rows
+        std::vector<unsigned char> compressed = { 0x78, 0x01 };
+        size_t offset = 0;
+        do {
+            size_t blockSize = std::min<size_t>(rows.size() - offset, 65535);
+            bool last = offset + blockSize == rows.size();
+            compressed.push_back(last ? 1 : 0);
+            compressed.push_back((unsigned char)blockSize);
+            compressed.push_back((unsigned char)(blockSize >> 8));
+            compressed.push_back((unsigned char)~blockSize);
+            compressed.push_back((unsigned char)(~blockSize >> 8));
+            compressed.insert(compressed.end(), rows.begin() + offset, rows.begin() + offset + blockSize);
+            offset += blockSize;
+        } while (offset < rows.size());
+
+        uint32_t adlerA = 1, adlerB = 0;
+        for (unsigned char byte : rows) {
+            adlerA = (adlerA + byte) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        PutBigEndian(compressed, (adlerB << 16) | adlerA);
+
+        WriteChunk(file, "IDAT", compressed);
+        WriteChunk(file, "IEND", {});
+
+        return file.good();
+    }
+
+}
@@ -0,0 +1,215 @@
+#include "shaderBuilder.h"
+#include "glState.h"
+#include "mappedFile.h"
+#include "hash.h"
+#include "echlib.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace ech {
+
+    static const char PROGRAM_CACHE_MAGIC[8] = { 'E', 'C', 'H', 'P', 'R', 'O', 'G', 0 };
+    static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+    static std::string shaderCacheDirectory;
+
+
+    bool SetShaderCacheDirectory(const std::string& directory) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "ERROR: Failed to create shader cache directory: " << directory << " (" << error.message() << ")" << std::endl;
+            return false;
+        }
+
+        shaderCacheDirectory = directory;
+        return true;
+    }
+
+    static bool CompileStage(GLuint shader, const char* source, const char* name, const char* stage) {
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+
+        int success;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
+            std::cerr << "ERROR: " << name << " " << stage << " Shader Compilation Failed\n" << infoLog << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static bool ProgramBinariesSupported() {
+        if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) {
+            return false;
+        }
+
+        // Some drivers expose the extension but no format to save in
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // Binaries only work on the driver that made them, so the driver strings are part of the key
+    static uint64_t ProgramCacheKey(const char* vertexSource, const char* fragmentSource) {
+        uint64_t key = HashBytes(vertexSource, strlen(vertexSource));
+        key = HashBytes(fragmentSource, strlen(fragmentSource), key);
+
+        for (GLenum property : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const char* value = (const char*)glGetString(property);
+            if (value) {
+                key = HashBytes(value, strlen(value), key);
+            }
+        }
+        return key;
+    }
+
+    static bool LoadProgramBinary(GLuint program, const std::string& filepath, uint64_t key) {
+        MappedFile file;
+        if (!file.Open(filepath.c_str())) {
+            return false;
+        }
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t format;
+            uint64_t key;
+            uint64_t length;
+        } header;
+
+        if (file.GetSize() < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, file.GetData(), sizeof(header));
+
+        if (memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != PROGRAM_CACHE_VERSION ||
+            header.key != key || header.length != file.GetSize() - sizeof(header)) {
+            return false;
+        }
+
+        glProgramBinary(program, (GLenum)header.format, file.GetData() + sizeof(header), (GLsizei)header.length);
+
+        // The driver may still refuse it (after an update for example), then the sources get compiled
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked != 0;
+    }
+
+    static void SaveProgramBinary(GLuint program, const std::string& filepath, uint64_t key) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        std::vector<unsigned char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for saving: " << filepath << std::endl;
+            return;
+        }
+
+        uint32_t version = PROGRAM_CACHE_VERSION;
+        uint32_t binaryFormat = format;
+        uint64_t binaryLength = (uint64_t)length;
+        file.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        file.write(reinterpret_cast<const char*>(&binaryFormat), sizeof(binaryFormat));
+        file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char*>(&binaryLength), sizeof(binaryLength));
+        file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+    }
+
+    // Binaries of name built from other sources (a shader that was edited or hot reloaded) are never loaded again
+    static void RemoveStaleProgramBinaries(const char* name, const std::string& keepPath) {
+        std::string prefix = std::string(name) + "_";
+        const std::string suffix = ".echprog";
+        const size_t keyLength = 16;
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(shaderCacheDirectory, error)) {
+            std::string filename = entry.path().filename().string();
+            if (filename.size() != prefix.size() + keyLength + suffix.size() ||
+                filename.compare(0, prefix.size(), prefix) != 0 ||
+                filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) != 0 ||
+                filename.find_first_not_of("0123456789abcdef", prefix.size()) != prefix.size() + keyLength) {
+                continue; // Another program, "text_sdf" files start with "text_" too
+            }
+
+            if (entry.path().string() != keepPath) {
+                std::filesystem::remove(entry.path(), error);
+            }
+        }
+    }
+
+    GLuint BuildShaderProgram(const char* name, const char* vertexSource, const char* fragmentSource) {
+        GLuint program = glCreateProgram();
+
+        bool cacheBinary = !shaderCacheDirectory.empty() && ProgramBinariesSupported();
+        uint64_t key = 0;
+        std::string cachePath;
+
+        if (cacheBinary) {
+            key = ProgramCacheKey(vertexSource, fragmentSource);
+
+            char cacheName[128];
+            snprintf(cacheName, sizeof(cacheName), "%s_%016llx.echprog", name, (unsigned long long)key);
+            cachePath = (std::filesystem::path(shaderCacheDirectory) / cacheName).string();
+
+            if (LoadProgramBinary(program, cachePath, key)) {
+                CacheProgramUniforms(program);
+                return program;
+            }
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+
+        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        bool compiled = CompileStage(vertexShader, vertexSource, name, "Vertex");
+        compiled = CompileStage(fragmentShader, fragmentSource, name, "Fragment") && compiled;
+
+        int success = 0;
+        if (compiled) {
+            glAttachShader(program, vertexShader);
+            glAttachShader(program, fragmentShader);
+            glLinkProgram(program);
+
+            char infoLog[512];
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            if (!success) {
+                glGetProgramInfoLog(program, 512, nullptr, infoLog);
+                std::cerr << "ERROR: " << name << " Shader Program Linking Failed\n" << infoLog << std::endl;
+            }
+
+            glDetachShader(program, vertexShader);
+            glDetachShader(program, fragmentShader);
+        }
+
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        if (!success) {
+            glDeleteProgram(program);
+            return 0;
+        }
+
+        CacheProgramUniforms(program);
+        if (cacheBinary) {
+            SaveProgramBinary(program, cachePath, key);
+            RemoveStaleProgramBinaries(name, cachePath);
+        }
+        return program;
+    }
+
+}
@@ -0,0 +1,213 @@
+#include "shaderRegistry.h"
+#include "shaderBuilder.h"
+#include "glState.h"
+#include "echlib.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#if defined(__linux__) && !PRODUCTION_BUILD
+#define ECH_SHADER_HOT_RELOAD 1
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+namespace ech {
+
+    struct RegisteredProgram {
+        std::filesystem::path vertexFile;
+        std::filesystem::path fragmentFile;
+        GLuint program;
+        bool dirty;     // One of the files changed, rebuilt by the next UpdateShaderRegistry
+    };
+
+    static std::unordered_map<std::string, RegisteredProgram> registeredPrograms;
+    static glm::mat4 registryViewProjection(1.0f);
+
+    static void ApplyViewProjection(GLuint program) {
+        UseProgram(program);
+        glUniformMatrix4fv(GetUniformLocation(program, "uViewProjection"), 1, GL_FALSE, glm::value_ptr(registryViewProjection));
+    }
+
+
+    static bool ReadTextFile(const std::filesystem::path& filepath, std::string& outText) {
+        std::ifstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for loading: " << filepath.string() << std::endl;
+            return false;
+        }
+
+        std::stringstream contents;
+        contents << file.rdbuf();
+        outText = contents.str();
+        return true;
+    }
+
+    // The old program is only replaced once the new one built, so a broken edit never leaves a hole
+    static bool BuildRegisteredProgram(const std::string& name, RegisteredProgram& entry) {
+        std::string vertexSource, fragmentSource;
+        if (!ReadTextFile(entry.vertexFile, vertexSource) || !ReadTextFile(entry.fragmentFile, fragmentSource)) {
+            return false;
+        }
+
+        GLuint program = BuildShaderProgram(name.c_str(), vertexSource.c_str(), fragmentSource.c_str());
+        if (!program) {
+            return false;
+        }
+
+        if (entry.program) {
+            ForgetProgramUniforms(entry.program);
+            glDeleteProgram(entry.program);
+        }
+        entry.program = program;
+        ApplyViewProjection(program);
+        return true;
+    }
+
+
+#ifdef ECH_SHADER_HOT_RELOAD
+
+    static int inotifyFile = -1;
+    static std::unordered_map<int, std::filesystem::path> watchedDirectories; // Watch descriptor -> directory
+
+    // Editors often save by writing a new file and renaming it over the old one, which ends a watch on
+    // the file itself. Watching the directory sees both kinds of save.
+    static void WatchDirectoryOf(const std::filesystem::path& filepath) {
+        if (inotifyFile < 0) {
+            inotifyFile = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (inotifyFile < 0) {
+                std::cerr << "Warning: inotify is not available, shaders won't hot reload" << std::endl;
+                return;
+            }
+        }
+
+        std::filesystem::path directory = filepath.parent_path();
+        if (directory.empty()) {
+            directory = ".";
+        }
+
+        for (const auto& watched : watchedDirectories) {
+            if (watched.second == directory) {
+                return;
+            }
+        }
+
+        int watch = inotify_add_watch(inotifyFile, directory.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch < 0) {
+            std::cerr << "Warning: Can't watch shader directory: " << directory.string() << std::endl;
+            return;
+        }
+        watchedDirectories[watch] = directory;
+    }
+
+    static void ReadFileEvents() {
+        alignas(inotify_event) char buffer[4096];
+
+        while (true) {
+            ssize_t length = read(inotifyFile, buffer, sizeof(buffer));
+            if (length <= 0) {
+                return; // EAGAIN, nothing left to read this frame
+            }
+
+            for (char* cursor = buffer; cursor < buffer + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(cursor);
+                cursor += sizeof(inotify_event) + event->len;
+
+                auto directory = watchedDirectories.find(event->wd);
+                if (event->len == 0 || directory == watchedDirectories.end()) {
+                    continue;
+                }
+
+                std::filesystem::path changed = (directory->second / event->name).lexically_normal();
+                for (auto& entry : registeredPrograms) {
+                    if (entry.second.vertexFile == changed || entry.second.fragmentFile == changed) {
+                        entry.second.dirty = true;
+                    }
+                }
+            }
+        }
+    }
+
+#endif
+
+
+    bool LoadShaderProgram(const std::string& name, const std::string& vertexFile, const std::string& fragmentFile) {
+        RegisteredProgram& entry = registeredPrograms[name];
+        entry.vertexFile = std::filesystem::path(vertexFile).lexically_normal();
+        entry.fragmentFile = std::filesystem::path(fragmentFile).lexically_normal();
+        entry.dirty = false;
+
+#ifdef ECH_SHADER_HOT_RELOAD
+        // Watched even if the first build fails, fixing the file is enough then
+        WatchDirectoryOf(entry.vertexFile);
+        WatchDirectoryOf(entry.fragmentFile);
+#endif
+
+        return BuildRegisteredProgram(name, entry);
+    }
+
+    GLuint GetShaderProgram(const std::string& name) {
+        auto entry = registeredPrograms.find(name);
+        if (entry == registeredPrograms.end()) {
+            return 0;
+        }
+        return entry->second.program;
+    }
+
+    void UpdateShaderRegistry() {
+#ifdef ECH_SHADER_HOT_RELOAD
+        if (inotifyFile < 0) {
+            return;
+        }
+
+        ReadFileEvents();
+
+        for (auto& entry : registeredPrograms) {
+            if (!entry.second.dirty) {
+                continue;
+            }
+            entry.second.dirty = false;
+
+            if (BuildRegisteredProgram(entry.first, entry.second)) {
+                std::cout << "Shader reloaded: " << entry.first << std::endl;
+            }
+            else if (entry.second.program) {
+                std::cerr << "Warning: Shader " << entry.first << " didn't build, keeping the last good program" << std::endl;
+            }
+        }
+#endif
+    }
+
+    void SetRegistryViewProjection(const glm::mat4& viewProjection) {
+        registryViewProjection = viewProjection;
+        for (auto& entry : registeredPrograms) {
+            if (entry.second.program) {
+                ApplyViewProjection(entry.second.program);
+            }
+        }
+    }
+
+    void ShutdownShaderRegistry() {
+        for (auto& entry : registeredPrograms) {
+            if (entry.second.program) {
+                ForgetProgramUniforms(entry.second.program);
+                glDeleteProgram(entry.second.program);
+            }
+        }
+        registeredPrograms.clear();
+
+#ifdef ECH_SHADER_HOT_RELOAD
+        if (inotifyFile >= 0) {
+            close(inotifyFile);
+            inotifyFile = -1;
+        }
+        watchedDirectories.clear();
+#endif
+    }
+
+}
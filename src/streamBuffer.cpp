@@ -0,0 +1,159 @@
+#include "streamBuffer.h"
+#include <iostream>
+
+
+namespace ech {
+
+    static size_t AlignUp(size_t value, size_t alignment) {
+        if (alignment <= 1) {
+            return value;
+        }
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void StreamBuffer::Init(GLenum bufferTarget, size_t size) {
+        target = bufferTarget;
+        segmentSize = size;
+        segment = 0;
+        segmentUsed = 0;
+
+        size_t totalSize = segmentSize * SEGMENT_COUNT;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+
+        // Persistent mapping needs immutable storage, so it is only possible with buffer storage
+        if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, totalSize, nullptr, flags);
+            persistentPointer = (unsigned char*)glMapBufferRange(target, 0, totalSize, flags);
+
+            if (persistentPointer) {
+                mode = StreamMode::PERSISTENT;
+                return;
+            }
+
+            // The storage is immutable now, start over with a fresh buffer
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(target, buffer);
+        }
+
+        glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+        mode = StreamMode::UNSYNCHRONIZED;
+    }
+
+    void StreamBuffer::Shutdown() {
+        for (GLsync& fence : fences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (persistentPointer) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            persistentPointer = nullptr;
+        }
+
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        staging.clear();
+    }
+
+    void StreamBuffer::WaitForSegment(int index) {
+        GLsync& fence = fences[index];
+        if (!fence) {
+            return;
+        }
+
+        // Usually the GPU finished this segment a frame ago and this returns right away
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    void StreamBuffer::NextSegment() {
+        if (segmentUsed > 0) {
+            if (fences[segment]) {
+                glDeleteSync(fences[segment]);
+            }
+            fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        segment = (segment + 1) % SEGMENT_COUNT;
+        segmentUsed = 0;
+        WaitForSegment(segment);
+    }
+
+    void* StreamBuffer::Map(size_t size, size_t alignment, size_t& outOffset) {
+        if (size > segmentSize) {
+            std::cerr << "ERROR: Stream buffer allocation of " << size << " bytes is bigger than a segment" << std::endl;
+            return nullptr;
+        }
+
+        size_t segmentStart = segment * segmentSize;
+        size_t offset = AlignUp(segmentStart + segmentUsed, alignment);
+
+        if (offset + size > segmentStart + segmentSize) {
+            NextSegment();
+            segmentStart = segment * segmentSize;
+            offset = AlignUp(segmentStart, alignment);
+
+            if (offset + size > segmentStart + segmentSize) {
+                return nullptr;
+            }
+        }
+
+        segmentUsed = offset + size - segmentStart;
+        bytesStreamed += size;
+
+        outOffset = offset;
+        mappedOffset = offset;
+        mappedSize = size;
+        mapped = true;
+
+        if (mode == StreamMode::PERSISTENT) {
+            return persistentPointer + offset;
+        }
+
+        if (mode == StreamMode::UNSYNCHRONIZED) {
+            // The fence already guarantees the GPU is not reading this range anymore
+            glBindBuffer(target, buffer);
+            void* pointer = glMapBufferRange(target, offset, size,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+
+            if (pointer) {
+                return pointer;
+            }
+
+            std::cerr << "Warning: glMapBufferRange failed, stream buffer falls back to glBufferSubData" << std::endl;
+            mode = StreamMode::SUB_DATA;
+        }
+
+        staging.resize(size);
+        return staging.data();
+    }
+
+    void StreamBuffer::Unmap() {
+        if (!mapped) {
+            return;
+        }
+        mapped = false;
+
+        if (mode == StreamMode::UNSYNCHRONIZED) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+        }
+        else if (mode == StreamMode::SUB_DATA) {
+            glBindBuffer(target, buffer);
+            glBufferSubData(target, mappedOffset, mappedSize, staging.data());
+        }
+    }
+
+}
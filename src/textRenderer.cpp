@@ -0,0 +1,228 @@
+#include "textRenderer.h"
+#include "glyphCache.h"
+#include "echlib.h"
+#include <algorithm>
+
+
+namespace ech {
+
+    float GetTextScale(const Font& font, int fontSize) {
+        if (font.glyphs && font.glyphs->IsSdf() && fontSize > 0 && font.size > 0) {
+            return (float)fontSize / font.size;
+        }
+        return 1.0f;
+    }
+
+    uint32_t NextCodepoint(const char*& text) {
+        const unsigned char* bytes = (const unsigned char*)text;
+
+        uint32_t codepoint;
+        int continuationBytes;
+        if (bytes[0] < 0x80) {
+            text++;
+            return bytes[0];
+        }
+        else if ((bytes[0] & 0xE0) == 0xC0) {
+            codepoint = bytes[0] & 0x1F;
+            continuationBytes = 1;
+        }
+        else if ((bytes[0] & 0xF0) == 0xE0) {
+            codepoint = bytes[0] & 0x0F;
+            continuationBytes = 2;
+        }
+        else if ((bytes[0] & 0xF8) == 0xF0) {
+            codepoint = bytes[0] & 0x07;
+            continuationBytes = 3;
+        }
+        else {
+            text++;
+            return 0xFFFD;
+        }
+
+        for (int i = 1; i <= continuationBytes; i++) {
+            // Also stops at the terminating 0, it is never a continuation byte
+            if ((bytes[i] & 0xC0) != 0x80) {
+                text += i;
+                return 0xFFFD;
+            }
+            codepoint = (codepoint << 6) | (bytes[i] & 0x3F);
+        }
+
+        text += continuationBytes + 1;
+        return codepoint;
+    }
+
+    // Pen position is on the baseline, the glyph's offsets place its bitmap around it
+    static void AppendGlyphQuad(const GlyphCache& glyphs, const GlyphCache::Glyph& glyph, float penX, float penY, float scale,
+        const Color& color, std::vector<BatchVertex>& outVertices) {
+        float textureWidth = (float)glyphs.GetAtlasWidth();
+        float textureHeight = (float)glyphs.GetAtlasHeight();
+
+        // yoff is how far the top of the glyph is below the baseline in the y-down bitmap
+        float left = penX + glyph.xoff * scale;
+        float right = left + glyph.width * scale;
+        float top = penY - glyph.yoff * scale;
+        float bottom = top - glyph.height * scale;
+
+        // Atlas rows are uploaded top to bottom, so glyph.y is the top of the glyph
+        float u0 = glyph.x / textureWidth;
+        float v0 = glyph.y / textureHeight;
+        float u1 = (glyph.x + glyph.width) / textureWidth;
+        float v1 = (glyph.y + glyph.height) / textureHeight;
+
+        outVertices.push_back({ left, bottom, u0, v1, color.r, color.g, color.b, color.a, 0.0f, 0.0f, 0.0f, 0.0f });
+        outVertices.push_back({ right, bottom, u1, v1, color.r, color.g, color.b, color.a, 0.0f, 0.0f, 0.0f, 0.0f });
+        outVertices.push_back({ right, top, u1, v0, color.r, color.g, color.b, color.a, 0.0f, 0.0f, 0.0f, 0.0f });
+        outVertices.push_back({ left, top, u0, v0, color.r, color.g, color.b, color.a, 0.0f, 0.0f, 0.0f, 0.0f });
+    }
+
+    void BuildTextVertices(const Font& font, const char* text, float x, float y, float scale, const Color& color, std::vector<BatchVertex>& outVertices) {
+        const GlyphCache& glyphs = *font.glyphs;
+
+        for (const char* p = text; *p; ) {
+            uint32_t codepoint = NextCodepoint(p);
+            if (codepoint < 32) {
+                continue;
+            }
+
+            const GlyphCache::Glyph* glyph = glyphs.FindGlyph(codepoint);
+            if (!glyph) {
+                continue; // Didn't fit in the atlas
+            }
+
+            // Spaces (and anything else without pixels) only move the pen
+            if (glyph->width > 0) {
+                AppendGlyphQuad(glyphs, *glyph, x, y, scale, color, outVertices);
+            }
+
+            x += glyph->advance * scale;
+        }
+    }
+
+    void BuildTextLayoutVertices(const Font& font, const TextLayout& layout, float x, float y, const Color& color, std::vector<BatchVertex>& outVertices) {
+        const GlyphCache& glyphs = *font.glyphs;
+
+        for (const TextLayoutGlyph& shaped : layout.glyphs) {
+            const GlyphCache::Glyph* glyph = glyphs.FindGlyph(shaped.codepoint);
+            if (glyph && glyph->width > 0) {
+                AppendGlyphQuad(glyphs, *glyph, x + shaped.x, y + shaped.y, layout.scale, color, outVertices);
+            }
+        }
+    }
+
+    void ShapeText(TextLayout& layout, Font& font, const char* text, int fontSize, float maxWidth) {
+        if (!font.glyphs || !text || RejectWhileRecording("ShapeText")) {
+            return;
+        }
+
+        float scale = GetTextScale(font, fontSize);
+        if (layout.shapedWith == font.glyphs.get() && layout.scale == scale && layout.maxWidth == maxWidth && layout.text == text) {
+            return;
+        }
+
+        layout.text = text;
+        layout.shapedWith = font.glyphs.get();
+        layout.scale = scale;
+        layout.maxWidth = maxWidth;
+        layout.glyphs.clear();
+
+        GlyphCache& glyphs = *font.glyphs;
+        glyphs.Prepare(text); // Advances come from the cached glyphs
+        float lineHeight = glyphs.GetLineHeight() * scale;
+
+        float penX = 0.0f;
+        float penY = 0.0f;
+        float widestLine = 0.0f;
+        int lineCount = 1;
+        uint32_t previous = 0;
+
+        // The word being written, it moves to the next line as a whole if it doesn't fit
+        size_t wordStart = 0;
+        float wordStartX = 0.0f;
+        bool lineHasSpace = false;
+        float widthBeforeSpace = 0.0f;
+
+        for (const char* p = text; *p; ) {
+            uint32_t codepoint = NextCodepoint(p);
+
+            if (codepoint == '\n') {
+                widestLine = std::max(widestLine, penX);
+                penX = 0.0f;
+                penY -= lineHeight;
+                lineCount++;
+                previous = 0;
+                wordStart = layout.glyphs.size();
+                wordStartX = 0.0f;
+                lineHasSpace = false;
+                continue;
+            }
+
+            if (codepoint < 32) {
+                continue;
+            }
+
+            const GlyphCache::Glyph* glyph = glyphs.FindGlyph(codepoint);
+            if (!glyph) {
+                continue;
+            }
+
+            // Kerning is only applied between glyphs that end up on the same line
+            float kerning = previous ? glyphs.GetKerning(previous, codepoint) * scale : 0.0f;
+            bool followsSpace = previous == ' ';
+            previous = codepoint;
+            float advance = glyph->advance * scale;
+            penX += kerning;
+
+            if (codepoint == ' ') {
+                widthBeforeSpace = penX;
+                penX += advance;
+                wordStart = layout.glyphs.size();
+                wordStartX = penX;
+                lineHasSpace = true;
+                continue;
+            }
+
+            if (followsSpace) {
+                // The word starts after its kerning against the space, so that pair stays behind on a wrap
+                wordStartX = penX;
+            }
+
+            if (maxWidth > 0.0f && penX + advance > maxWidth && penX > 0.0f) {
+                if (lineHasSpace) {
+                    // Wrap at the last space, the word written so far moves down with this glyph
+                    widestLine = std::max(widestLine, widthBeforeSpace);
+                    for (size_t i = wordStart; i < layout.glyphs.size(); i++) {
+                        layout.glyphs[i].x -= wordStartX;
+                        layout.glyphs[i].y -= lineHeight;
+                    }
+                    penX -= wordStartX;
+                }
+                else {
+                    // One word longer than the line, break it right here
+                    widestLine = std::max(widestLine, penX - kerning);
+                    penX = 0.0f;
+                    wordStart = layout.glyphs.size();
+                }
+
+                penY -= lineHeight;
+                lineCount++;
+                wordStartX = 0.0f;
+                lineHasSpace = false;
+            }
+
+            if (glyph->width > 0) {
+                layout.glyphs.push_back({ codepoint, penX, penY });
+            }
+            penX += advance;
+        }
+
+        widestLine = std::max(widestLine, penX);
+
+        layout.lineCount = lineCount;
+        layout.minX = 0.0f;
+        layout.maxX = widestLine;
+        layout.maxY = glyphs.GetAscent() * scale;
+        layout.minY = penY + glyphs.GetDescent() * scale;
+    }
+
+}
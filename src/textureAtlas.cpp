@@ -0,0 +1,328 @@
+#include "textureAtlas.h"
+#include <stb_image/stb_image.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+
+
+namespace ech {
+
+    // Empty pixels left around every image so filtering never picks up a neighbour
+    static const int ATLAS_PADDING = 2;
+
+    static const char ATLAS_MAGIC[8] = { 'E', 'C', 'H', 'A', 'T', 'L', 'A', 'S' };
+    static const uint32_t ATLAS_VERSION = 1;
+
+    // Largest page ReadAtlas accepts, anything bigger is a broken file rather than a real atlas
+    static const int MAX_ATLAS_PAGE_SIZE = 16384;
+
+
+    void SkylinePacker::Init(int width, int height) {
+        pageWidth = width;
+        pageHeight = height;
+        usedHeight = 0;
+        skyline.clear();
+        skyline.push_back({ 0, 0, width });
+    }
+
+    int SkylinePacker::Fit(size_t index, int width, int height) const {
+        int x = skyline[index].x;
+        if (x + width > pageWidth) {
+            return -1;
+        }
+
+        // The rectangle rests on the highest skyline segment it spans
+        int y = 0;
+        int widthLeft = width;
+        for (size_t i = index; widthLeft > 0; i++) {
+            if (i == skyline.size()) {
+                return -1;
+            }
+            y = std::max(y, skyline[i].y);
+            if (y + height > pageHeight) {
+                return -1;
+            }
+            widthLeft -= skyline[i].width;
+        }
+        return y;
+    }
+
+    bool SkylinePacker::Insert(int width, int height, int& outX, int& outY) {
+        int bestIndex = -1;
+        int bestY = pageHeight;
+        int bestWidth = pageWidth;
+
+        for (size_t i = 0; i < skyline.size(); i++) {
+            int y = Fit(i, width, height);
+            if (y < 0) {
+                continue;
+            }
+            // Lowest spot wins, ties go to the narrowest segment to waste less space
+            if (bestIndex < 0 || y < bestY || (y == bestY && skyline[i].width < bestWidth)) {
+                bestIndex = (int)i;
+                bestY = y;
+                bestWidth = skyline[i].width;
+            }
+        }
+
+        if (bestIndex < 0) {
+            return false;
+        }
+
+        outX = skyline[bestIndex].x;
+        outY = bestY;
+
+        // New segment on top of the rectangle, then cut away what it covers
+        Node node = { outX, bestY + height, width };
+        skyline.insert(skyline.begin() + bestIndex, node);
+
+        for (size_t i = bestIndex + 1; i < skyline.size(); ) {
+            Node& previous = skyline[i - 1];
+            Node& current = skyline[i];
+            if (current.x >= previous.x + previous.width) {
+                break;
+            }
+
+            int shrink = previous.x + previous.width - current.x;
+            current.x += shrink;
+            current.width -= shrink;
+            if (current.width <= 0) {
+                skyline.erase(skyline.begin() + i);
+                continue;
+            }
+            break;
+        }
+
+        // Merge neighbours at the same height
+        for (size_t i = 0; i + 1 < skyline.size(); ) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            }
+            else {
+                i++;
+            }
+        }
+
+        usedHeight = std::max(usedHeight, bestY + height);
+        return true;
+    }
+
+
+    bool PackAtlas(const std::vector<std::pair<std::string, std::string>>& images, int pageSize, AtlasData& outAtlas) {
+        struct Image {
+            std::string name;
+            unsigned char* pixels;
+            int width, height;
+        };
+
+        std::vector<Image> loaded;
+        for (const auto& image : images) {
+            int width, height, channels;
+            unsigned char* pixels = stbi_load(image.second.c_str(), &width, &height, &channels, 4);
+            if (!pixels) {
+                std::cerr << "ERROR: Failed to load atlas image: " << image.second << std::endl;
+                continue;
+            }
+            if (width + ATLAS_PADDING > pageSize || height + ATLAS_PADDING > pageSize) {
+                std::cerr << "ERROR: Image is bigger than an atlas page: " << image.second << std::endl;
+                stbi_image_free(pixels);
+                continue;
+            }
+            loaded.push_back({ image.first, pixels, width, height });
+        }
+
+        // Tallest first packs a skyline much tighter
+        std::sort(loaded.begin(), loaded.end(), [](const Image& a, const Image& b) {
+            return a.height != b.height ? a.height > b.height : a.width > b.width;
+            });
+
+        std::vector<SkylinePacker> packers;
+        outAtlas = {};
+        outAtlas.pageWidth = pageSize;
+
+        for (const Image& image : loaded) {
+            int page = -1, x = 0, y = 0;
+            for (size_t i = 0; i < packers.size(); i++) {
+                if (packers[i].Insert(image.width + ATLAS_PADDING, image.height + ATLAS_PADDING, x, y)) {
+                    page = (int)i;
+                    break;
+                }
+            }
+
+            if (page < 0) {
+                packers.emplace_back();
+                packers.back().Init(pageSize, pageSize);
+                packers.back().Insert(image.width + ATLAS_PADDING, image.height + ATLAS_PADDING, x, y);
+                outAtlas.pages.emplace_back((size_t)pageSize * pageSize * 4, 0);
+                page = (int)packers.size() - 1;
+            }
+
+            std::vector<unsigned char>& pixels = outAtlas.pages[page];
+            for (int row = 0; row < image.height; row++) {
+                memcpy(&pixels[((size_t)(y + row) * pageSize + x) * 4], &image.pixels[(size_t)row * image.width * 4], (size_t)image.width * 4);
+            }
+
+            outAtlas.entries.push_back({ image.name, page, x, y, image.width, image.height });
+            stbi_image_free(image.pixels);
+        }
+
+        // Rows are stored top to bottom, so dropping the unused bottom of a page is just a resize
+        for (size_t i = 0; i < packers.size(); i++) {
+            int height = std::max(packers[i].GetUsedHeight(), 1);
+            outAtlas.pageHeights.push_back(height);
+            outAtlas.pages[i].resize((size_t)pageSize * height * 4);
+        }
+
+        return !outAtlas.entries.empty();
+    }
+
+
+    // Layout: magic, version, page width, page count, entry count,
+    // then every entry (name length, name, page, x, y, width, height),
+    // then every page (height, RGBA pixels)
+    bool SaveAtlas(const AtlasData& atlas, const char* filepath) {
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for saving: " << filepath << std::endl;
+            return false;
+        }
+
+        auto write = [&file](uint32_t value) {
+            file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            };
+
+        file.write(ATLAS_MAGIC, sizeof(ATLAS_MAGIC));
+        write(ATLAS_VERSION);
+        write((uint32_t)atlas.pageWidth);
+        write((uint32_t)atlas.pages.size());
+        write((uint32_t)atlas.entries.size());
+
+        for (const AtlasEntry& entry : atlas.entries) {
+            write((uint32_t)entry.name.size());
+            file.write(entry.name.data(), entry.name.size());
+            write((uint32_t)entry.page);
+            write((uint32_t)entry.x);
+            write((uint32_t)entry.y);
+            write((uint32_t)entry.width);
+            write((uint32_t)entry.height);
+        }
+
+        for (size_t i = 0; i < atlas.pages.size(); i++) {
+            write((uint32_t)atlas.pageHeights[i]);
+            file.write(reinterpret_cast<const char*>(atlas.pages[i].data()), atlas.pages[i].size());
+        }
+
+        return file.good();
+    }
+
+    bool ReadAtlas(const char* filepath, AtlasData& outAtlas) {
+        std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file for loading: " << filepath << std::endl;
+            return false;
+        }
+
+        // Every length in the file is checked against what is left of it before anything is allocated
+        uint64_t remaining = (uint64_t)file.tellg();
+        file.seekg(0);
+        bool truncated = false;
+
+        auto readBytes = [&](void* destination, uint64_t size) {
+            if (truncated || size > remaining) {
+                truncated = true;
+                return;
+            }
+            file.read(reinterpret_cast<char*>(destination), (std::streamsize)size);
+            remaining -= size;
+            };
+        auto read = [&]() {
+            uint32_t value = 0;
+            readBytes(&value, sizeof(value));
+            return value;
+            };
+
+        // Nothing half read is handed back
+        auto fail = [filepath, &outAtlas](const char* reason) {
+            std::cerr << "ERROR: Invalid atlas file (" << reason << "): " << filepath << std::endl;
+            outAtlas = {};
+            return false;
+            };
+
+        char magic[sizeof(ATLAS_MAGIC)] = {};
+        readBytes(magic, sizeof(magic));
+        if (truncated || memcmp(magic, ATLAS_MAGIC, sizeof(magic)) != 0 || read() != ATLAS_VERSION) {
+            std::cerr << "ERROR: Not an atlas file (or an old version): " << filepath << std::endl;
+            return false;
+        }
+
+        outAtlas = {};
+        uint32_t pageWidth = read();
+        uint32_t pageCount = read();
+        uint32_t entryCount = read();
+
+        // An entry is at least 6 values, a page at least its height and one row of pixels
+        const uint64_t minEntrySize = 6 * sizeof(uint32_t);
+        if (truncated || pageWidth == 0 || pageWidth > (uint32_t)MAX_ATLAS_PAGE_SIZE || pageCount == 0 ||
+            (uint64_t)entryCount * minEntrySize + (uint64_t)pageCount * (sizeof(uint32_t) + pageWidth * 4) > remaining) {
+            return fail("header");
+        }
+        outAtlas.pageWidth = (int)pageWidth;
+
+        for (uint32_t i = 0; i < entryCount; i++) {
+            uint32_t nameLength = read();
+            if (truncated || nameLength > remaining) {
+                return fail("entry name");
+            }
+
+            AtlasEntry entry;
+            entry.name.resize(nameLength);
+            readBytes(&entry.name[0], nameLength);
+
+            uint32_t page = read();
+            uint32_t x = read();
+            uint32_t y = read();
+            uint32_t width = read();
+            uint32_t height = read();
+
+            // The y bound needs the page heights, it is checked once the pages are read
+            if (truncated || page >= pageCount || width == 0 || height == 0 ||
+                x > pageWidth || width > pageWidth - x || y > (uint32_t)MAX_ATLAS_PAGE_SIZE || height > (uint32_t)MAX_ATLAS_PAGE_SIZE) {
+                return fail("entry bounds");
+            }
+
+            entry.page = (int)page;
+            entry.x = (int)x;
+            entry.y = (int)y;
+            entry.width = (int)width;
+            entry.height = (int)height;
+            outAtlas.entries.push_back(std::move(entry));
+        }
+
+        for (uint32_t i = 0; i < pageCount; i++) {
+            uint32_t height = read();
+            uint64_t size = (uint64_t)pageWidth * height * 4;
+            if (truncated || height == 0 || height > (uint32_t)MAX_ATLAS_PAGE_SIZE || size > remaining) {
+                return fail("page size");
+            }
+
+            outAtlas.pageHeights.push_back((int)height);
+            outAtlas.pages.emplace_back((size_t)size);
+            readBytes(outAtlas.pages.back().data(), size);
+        }
+
+        for (const AtlasEntry& entry : outAtlas.entries) {
+            if (entry.y + entry.height > outAtlas.pageHeights[entry.page]) {
+                return fail("entry outside its page");
+            }
+        }
+
+        if (truncated || !file.good()) {
+            return fail("truncated");
+        }
+        return true;
+    }
+
+}
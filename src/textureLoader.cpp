@@ -0,0 +1,146 @@
+#include "textureLoader.h"
+#include "glState.h"
+#include <stb_image/stb_image.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+
+namespace ech {
+
+    void TextureLoader::Start(int threadCount) {
+        if (IsRunning()) {
+            return;
+        }
+
+        stopping = false;
+        for (int i = 0; i < threadCount; i++) {
+            workers.emplace_back(&TextureLoader::WorkerLoop, this);
+        }
+        glGenBuffers(1, &pixelBuffer);
+    }
+
+    void TextureLoader::Stop() {
+        if (!IsRunning()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            requests.clear();
+        }
+        wakeUp.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+
+        for (Decoded& image : decoded) {
+            stbi_image_free(image.pixels);
+        }
+        decoded.clear();
+
+        glDeleteBuffers(1, &pixelBuffer);
+        pixelBuffer = 0;
+    }
+
+    void TextureLoader::Queue(uint64_t id, const std::string& filepath) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({ id, filepath });
+        }
+        wakeUp.notify_one();
+    }
+
+    void TextureLoader::WorkerLoop() {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return stopping || !requests.empty(); });
+                if (stopping) {
+                    return;
+                }
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            // Always 4 channels, so every row is 4 byte aligned and the upload path is the same for all images
+            Decoded image = { request.id, nullptr, 0, 0 };
+            int channels;
+            image.pixels = stbi_load(request.filepath.c_str(), &image.width, &image.height, &channels, 4);
+            if (!image.pixels) {
+                std::cerr << "ERROR: Failed to load texture: " << request.filepath << std::endl;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                stbi_image_free(image.pixels);
+                return;
+            }
+            decoded.push_back(image);
+        }
+    }
+
+    GLuint TextureLoader::UploadImage(const Decoded& image) {
+        size_t size = (size_t)image.width * image.height * 4;
+
+        // Orphan the buffer first, so the driver never waits for the previous upload to be read
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        void* pointer = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (pointer) {
+            memcpy(pointer, image.pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        else {
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, image.pixels);
+        }
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        BindTexture(texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        // With a pixel buffer bound the last argument is an offset into it, the copy happens on the GPU's time
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        // Everything else still passes client memory to glTexImage2D
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return texture;
+    }
+
+    void TextureLoader::Upload(double budgetMs, const std::function<void(const Result&)>& onFinished) {
+        auto start = std::chrono::steady_clock::now();
+
+        while (true) {
+            Decoded image;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (decoded.empty()) {
+                    return;
+                }
+                image = decoded.front();
+                decoded.pop_front();
+            }
+
+            Result result = { image.id, 0, image.width, image.height };
+            if (image.pixels) {
+                result.texture = UploadImage(image);
+                stbi_image_free(image.pixels);
+            }
+            onFinished(result);
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budgetMs) {
+                return;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,190 @@
+#include "echlib.h"
+#include "batchRenderer.h"
+#include "glState.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+
+namespace ech {
+
+    // Chunks only need a position and a UV, the tint is the same for every tile (see Draw)
+    struct TileVertex {
+        float x, y;
+        float u, v;
+    };
+
+    bool Tilemap::Create(int width, int height, float tileSize, TextureHandle tileset, int tilePixelWidth, int tilePixelHeight, float originX, float originY) {
+        Destroy();
+
+        if (width <= 0 || height <= 0 || tileSize <= 0.0f || tilePixelWidth <= 0 || tilePixelHeight <= 0) {
+            std::cerr << "ERROR: Tilemap needs a positive size, tile size and tile pixel size" << std::endl;
+            return false;
+        }
+
+        this->width = width;
+        this->height = height;
+        this->tileSize = tileSize;
+        this->originX = originX;
+        this->originY = originY;
+        this->tileset = tileset;
+        this->tilePixelWidth = tilePixelWidth;
+        this->tilePixelHeight = tilePixelHeight;
+
+        chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        tiles.assign((size_t)width * height, -1);
+        chunks.assign((size_t)chunksX * chunksY, Chunk());
+        builtWith = {};
+        return true;
+    }
+
+    void Tilemap::Destroy() {
+        // The state cache would skip binding a new VAO that reuses a deleted id
+        if (!chunks.empty()) {
+            BindVertexArray(0);
+        }
+
+        for (Chunk& chunk : chunks) {
+            if (chunk.vao) {
+                glDeleteVertexArrays(1, &chunk.vao);
+                glDeleteBuffers(1, &chunk.vbo);
+            }
+        }
+        chunks.clear();
+        tiles.clear();
+        width = height = chunksX = chunksY = 0;
+    }
+
+    void Tilemap::SetTile(int x, int y, int tile) {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return;
+        }
+
+        int& current = tiles[(size_t)y * width + x];
+        if (current == tile) {
+            return;
+        }
+        current = tile;
+        chunks[(size_t)(y / CHUNK_SIZE) * chunksX + x / CHUNK_SIZE].dirty = true;
+    }
+
+    int Tilemap::GetTile(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return -1;
+        }
+        return tiles[(size_t)y * width + x];
+    }
+
+    void Tilemap::BuildChunk(int chunkX, int chunkY, const TextureRegion& region) {
+        Chunk& chunk = chunks[(size_t)chunkY * chunksX + chunkX];
+
+        if (!chunk.vao) {
+            glGenVertexArrays(1, &chunk.vao);
+            glGenBuffers(1, &chunk.vbo);
+
+            BindVertexArray(chunk.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TileVertex), (void*)offsetof(TileVertex, x));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TileVertex), (void*)offsetof(TileVertex, u));
+            glEnableVertexAttribArray(1);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GetQuadIndexBuffer());
+        }
+
+        // The tileset can be an atlas image, so tiles are cut out of its region and not the whole texture
+        int columns = std::max(region.width / tilePixelWidth, 1);
+        float uPerPixel = (region.u1 - region.u0) / region.width;
+        float vPerPixel = (region.v1 - region.v0) / region.height;
+        float tileU = tilePixelWidth * uPerPixel;
+        float tileV = tilePixelHeight * vPerPixel;
+
+        static std::vector<TileVertex> vertices;
+        vertices.clear();
+
+        int endX = std::min((chunkX + 1) * CHUNK_SIZE, width);
+        int endY = std::min((chunkY + 1) * CHUNK_SIZE, height);
+        for (int y = chunkY * CHUNK_SIZE; y < endY; y++) {
+            for (int x = chunkX * CHUNK_SIZE; x < endX; x++) {
+                int tile = tiles[(size_t)y * width + x];
+                if (tile < 0) {
+                    continue;
+                }
+
+                float u0 = region.u0 + (tile % columns) * tileU;
+                float v0 = region.v0 + (tile / columns) * tileV; // Top of the tile, image rows go top to bottom
+                float u1 = u0 + tileU;
+                float v1 = v0 + tileV;
+
+                float left = originX + x * tileSize;
+                float bottom = originY + y * tileSize;
+                vertices.push_back({ left, bottom, u0, v1 });
+                vertices.push_back({ left + tileSize, bottom, u1, v1 });
+                vertices.push_back({ left + tileSize, bottom + tileSize, u1, v0 });
+                vertices.push_back({ left, bottom + tileSize, u0, v0 });
+            }
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TileVertex), vertices.data(), GL_STATIC_DRAW);
+
+        chunk.quadCount = (int)(vertices.size() / 4);
+        chunk.dirty = false;
+    }
+
+    void Tilemap::Draw(GLuint program, float minX, float minY, float maxX, float maxY) {
+        const TextureRegion* region = GetTextureRegion(tileset);
+        if (!region || chunks.empty()) {
+            return;
+        }
+
+        // The tileset got reloaded or moved, every chunk has old UVs
+        if (region->textureID != builtWith.textureID || region->u0 != builtWith.u0 || region->v0 != builtWith.v0 ||
+            region->u1 != builtWith.u1 || region->v1 != builtWith.v1) {
+            for (Chunk& chunk : chunks) {
+                chunk.dirty = true;
+            }
+            builtWith = *region;
+        }
+
+        // Only the chunks under the view rectangle, the rest isn't even looked at
+        float chunkWorldSize = tileSize * CHUNK_SIZE;
+        int firstX = std::max((int)std::floor((minX - originX) / chunkWorldSize), 0);
+        int firstY = std::max((int)std::floor((minY - originY) / chunkWorldSize), 0);
+        int lastX = std::min((int)std::floor((maxX - originX) / chunkWorldSize), chunksX - 1);
+        int lastY = std::min((int)std::floor((maxY - originY) / chunkWorldSize), chunksY - 1);
+        if (firstX > lastX || firstY > lastY) {
+            CountCullResult(false, chunksX * chunksY);
+            return;
+        }
+
+        int visibleChunks = (lastX - firstX + 1) * (lastY - firstY + 1);
+        CountCullResult(true, visibleChunks);
+        CountCullResult(false, chunksX * chunksY - visibleChunks);
+
+        FlushBatch(); // Everything drawn before the map stays below it
+
+        UseProgram(program);
+        BindTexture(region->textureID);
+        glVertexAttrib4f(2, 1.0f, 1.0f, 1.0f, 1.0f); // No color array in the chunks, every tile gets this tint
+
+        RenderStats& stats = GetFrameStats();
+        for (int chunkY = firstY; chunkY <= lastY; chunkY++) {
+            for (int chunkX = firstX; chunkX <= lastX; chunkX++) {
+                Chunk& chunk = chunks[(size_t)chunkY * chunksX + chunkX];
+                if (chunk.dirty) {
+                    BuildChunk(chunkX, chunkY, *region);
+                }
+                if (chunk.quadCount == 0) {
+                    continue;
+                }
+
+                BindVertexArray(chunk.vao);
+                glDrawElements(GL_TRIANGLES, chunk.quadCount * 6, GL_UNSIGNED_INT, 0);
+                stats.drawCalls++;
+                stats.quads += chunk.quadCount;
+            }
+        }
+    }
+
+}
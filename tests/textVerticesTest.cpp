@@ -0,0 +1,164 @@
+// Checks the quads BuildTextVertices produces against the glyph metrics they come from.
+// Runs without a window or GL context: the few GL calls of the glyph cache go to the no-op stubs below.
+#include "echlib.h"
+#include "glyphCache.h"
+#include "textRenderer.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+namespace ech {
+
+    // The engine functions the glyph cache calls, the real ones need a window
+    float transparency = 1.0f; // The color constants in echlib.h read it
+    static FrameContext testFrameContext = {};
+    const FrameContext& GetFrameContext() { return testFrameContext; }
+    void BindTexture(GLuint) {}
+    void FlushBatch() {}
+
+}
+
+using namespace ech;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static bool Near(float a, float b) {
+    return std::fabs(a - b) < 0.0001f;
+}
+
+static void StubGl() {
+    glad_glGenTextures = [](GLsizei count, GLuint* textures) {
+        for (GLsizei i = 0; i < count; i++) {
+            textures[i] = 1;
+        }
+        };
+    glad_glTexParameteri = [](GLenum, GLenum, GLint) {};
+    glad_glPixelStorei = [](GLenum, GLint) {};
+    glad_glTexImage2D = [](GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void*) {};
+    glad_glTexSubImage2D = [](GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void*) {};
+}
+
+// The quad vertices start at first, bottom-left, bottom-right, top-right, top-left, for a glyph with its pen at penX, penY
+static void CheckGlyphQuad(const std::vector<BatchVertex>& vertices, size_t first, const GlyphCache& glyphs,
+    const GlyphCache::Glyph& glyph, float penX, float penY, float scale, const Color& color) {
+    float left = penX + glyph.xoff * scale;
+    float right = left + glyph.width * scale;
+    float top = penY - glyph.yoff * scale;
+    float bottom = top - glyph.height * scale;
+
+    float u0 = glyph.x / (float)glyphs.GetAtlasWidth();
+    float v0 = glyph.y / (float)glyphs.GetAtlasHeight();
+    float u1 = (glyph.x + glyph.width) / (float)glyphs.GetAtlasWidth();
+    float v1 = (glyph.y + glyph.height) / (float)glyphs.GetAtlasHeight();
+
+    const float expected[4][4] = {
+        { left, bottom, u0, v1 },
+        { right, bottom, u1, v1 },
+        { right, top, u1, v0 },
+        { left, top, u0, v0 }
+    };
+
+    for (int i = 0; i < 4; i++) {
+        const BatchVertex& vertex = vertices[first + i];
+        CHECK(Near(vertex.x, expected[i][0]));
+        CHECK(Near(vertex.y, expected[i][1]));
+        CHECK(Near(vertex.u, expected[i][2]));
+        CHECK(Near(vertex.v, expected[i][3]));
+        CHECK(vertex.r == color.r && vertex.g == color.g && vertex.b == color.b && vertex.a == color.a);
+        CHECK(vertex.halfWidth == 0.0f && vertex.halfHeight == 0.0f && vertex.cornerRadius == 0.0f && vertex.thickness == 0.0f);
+    }
+}
+
+int main() {
+    StubGl();
+
+    std::ifstream file(TEST_FONT_PATH, std::ios::binary);
+    std::vector<unsigned char> fontData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (fontData.empty()) {
+        std::printf("Can't read the test font: %s\n", TEST_FONT_PATH);
+        return 1;
+    }
+
+    Font font;
+    font.glyphs = std::make_shared<GlyphCache>();
+    font.size = 32;
+    if (!font.glyphs->Init(fontData, 32.0f)) {
+        std::printf("Can't load the test font\n");
+        return 1;
+    }
+    font.glyphs->Prepare("A ");
+
+    const GlyphCache& glyphs = *font.glyphs;
+    const GlyphCache::Glyph* a = glyphs.FindGlyph('A');
+    const GlyphCache::Glyph* space = glyphs.FindGlyph(' ');
+    CHECK(a && a->width > 0 && a->height > 0);
+    CHECK(space && space->width == 0 && space->advance > 0.0f);
+    if (!a || !space) {
+        return 1;
+    }
+
+    const Color color = { 0.25f, 0.5f, 0.75f, 1.0f };
+    const float x = 10.0f, y = 20.0f;
+    std::vector<BatchVertex> vertices;
+
+    // A normal glyph is one quad placed by its offsets around the pen
+    BuildTextVertices(font, "A", x, y, 1.0f, color, vertices);
+    CHECK(vertices.size() == 4);
+    if (vertices.size() == 4) {
+        CheckGlyphQuad(vertices, 0, glyphs, *a, x, y, 1.0f, color);
+    }
+
+    // A space only moves the pen
+    vertices.clear();
+    BuildTextVertices(font, " ", x, y, 1.0f, color, vertices);
+    CHECK(vertices.empty());
+
+    vertices.clear();
+    BuildTextVertices(font, " A", x, y, 1.0f, color, vertices);
+    CHECK(vertices.size() == 4);
+    if (vertices.size() == 4) {
+        CheckGlyphQuad(vertices, 0, glyphs, *a, x + space->advance, y, 1.0f, color);
+    }
+
+    // A glyph that was never prepared is skipped without moving the pen (U+4E00)
+    CHECK(glyphs.FindGlyph(0x4E00) == nullptr);
+    vertices.clear();
+    BuildTextVertices(font, "\xE4\xB8\x80" "A", x, y, 1.0f, color, vertices);
+    CHECK(vertices.size() == 4);
+    if (vertices.size() == 4) {
+        CheckGlyphQuad(vertices, 0, glyphs, *a, x, y, 1.0f, color);
+    }
+
+    // A newline is a control character, it neither draws nor moves the pen (multi line text goes through ShapeText)
+    vertices.clear();
+    BuildTextVertices(font, "A\nA", x, y, 1.0f, color, vertices);
+    CHECK(vertices.size() == 8);
+    if (vertices.size() == 8) {
+        CheckGlyphQuad(vertices, 0, glyphs, *a, x, y, 1.0f, color);
+        CheckGlyphQuad(vertices, 4, glyphs, *a, x + a->advance, y, 1.0f, color);
+    }
+
+    // scale multiplies offsets, sizes and advances but not the pen start
+    vertices.clear();
+    BuildTextVertices(font, " A", x, y, 2.0f, color, vertices);
+    CHECK(vertices.size() == 4);
+    if (vertices.size() == 4) {
+        CheckGlyphQuad(vertices, 0, glyphs, *a, x + space->advance * 2.0f, y, 2.0f, color);
+    }
+
+    if (failures > 0) {
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("Text vertex layouts OK\n");
+    return 0;
+}